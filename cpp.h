@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include "page_elements.h"
+
 #include <primitives/string.h>
 #include <primitives/filesystem.h>
 
@@ -240,63 +242,3 @@ struct cppreference_website {
     }
 };
 
-namespace page_elements {
-
-struct page {
-    std::string value;
-};
-struct title {
-    std::string value;
-};
-struct header {
-    int level;
-};
-struct header_end {};
-struct link {
-    std::string value;
-};
-struct link_end{};
-
-struct code{};
-struct code_end {};
-
-struct code_tag {};
-struct code_tag_end {};
-
-struct table{};
-struct table_end{};
-struct next_row {
-    int rowspan;
-};
-struct next_col {
-    int colspan;
-};
-
-struct paragraph{};
-struct cite {};
-
-struct bold {};
-struct monospace {};
-struct italic {};
-#undef small
-struct small {};
-struct abbr {};
-
-struct ul {};
-struct ol {};
-struct li {};
-
-struct dl {};
-struct dd {};
-struct dt {};
-
-struct blockquote {};
-struct img {};
-struct caption {};
-struct sub {};
-struct sup {};
-
-struct template_ {};
-struct br {};
-
-} // namespace page_elements
@@ -4,257 +4,174 @@
 // also see https://github.com/PeterFeicht/cppreference-doc
 
 //#include "cpp.h"
+#include "crawler.h"
+#include "page_elements.h"
+#include "perfect_hash.h"
+#include "snapshot_pack.h"
 
 //#include <primitives/emitter.h>
-#include <primitives/executor.h>
-#include <primitives/http.h>
 #include <primitives/sw/main.h>
-#include <primitives/templates2/sqlite.h>
 //#include <primitives/templates2/xml.h>
-#include <primitives/templates2/html.h>
 #include <nlohmann/json.hpp>
 
 #include <algorithm>
+#include <bitset>
+#include <condition_variable>
+#include <exception>
 #include <format>
+#include <mutex>
+#include <optional>
 #include <print>
 #include <ranges>
 #include <syncstream>
+#include <thread>
 #include <variant>
 
-// find all templates in data dir
-// grep "=Template:\K.*(?=&)" -r . -o -P -h | sort | uniq
-
-namespace db::parser {
-
-using namespace primitives::sqlite::db;
-
-struct schema {
-    struct tables_ {
-        struct page {
-            type<int64_t, primary_key{}, autoincrement{}> page_id;
-            type<std::string, unique{}> name;
-            type<std::string> source;
-        } page_;
-    } tables;
-};
-
-} // namespace db::parser
-
-struct url_request_cache : primitives::sqlite::kv<std::string, std::string> {};
-static auto &cache() {
-    // init once first
-    static auto f = []() {
-        primitives::sqlite::cache <
-            url_request_cache
-        > c{ "cache.db" };
-        c.enable_wal();
-        c.set_busy_timeout(5s);
-        return c;
-        };
-    static auto c = f();
-    thread_local auto tl = f();
-    return tl;
+static cl::opt<std::string> export_pack_file("export-pack", cl::desc("Write the crawl store into a single mmap-able snapshot pack and exit"));
+static cl::opt<std::string> pack_file("pack", cl::desc("Convert from a snapshot pack instead of crawling"));
+static cl::opt<bool> convert_cpp("cpp", cl::desc("Convert --pages into C++ headers in --cpp-out instead of exporting templates"));
+static cl::opt<std::string> cpp_out("cpp-out", cl::desc("Output directory of --cpp"), cl::init("generated/cpp"s));
+static cl::opt<std::string> convert_pages("pages", cl::desc("Page names to convert, a sqlite GLOB pattern: '*', '?', [a-z] and [^a-z]"), cl::init("Main_Page"));
+static cl::opt<int> convert_jobs("convert-jobs", cl::desc("Pages converted in parallel, 1 converts on the main thread"), cl::init((int)std::thread::hardware_concurrency()));
+static cl::opt<bool> output_digest("output-digest", cl::desc("Print one hash of all headers of --cpp, equal for any --convert-jobs; reads every header"));
+
+// the pack, when converting offline
+static const snapshot_pack *pack() {
+    static auto p = pack_file.empty() ? nullptr : std::make_unique<snapshot_pack>(pack_file.getValue());
+    return p.get();
 }
-
-const path mirror_root_dir = "cppreference";
-
-auto url_base = "cppreference.com"s;
-//auto lang = "en"s;
-auto lang = "dev"s;
-auto protocol = "https"s;
-//auto normal_page = "/w"s;
-auto normal_page = ""s;
-
-
-auto make_base_url() {
-    return std::format("{}://{}.{}", protocol, lang, url_base);
-}
-auto make_normal_page_url(auto &&page) {
-    if (page.starts_with("http")) {
-        return page;
-    }
-    return std::format("{}{}/{}", make_base_url(), normal_page,
-        //primitives::http::url_encode(page)
-        page
-    );
-}
-auto make_edit_page_url(auto &&page) {
-    if (page.starts_with("http")) {
-        throw;
-    }
-    return make_normal_page_url(std::format("index.php?title={}&action=edit", page));
-}
-
-auto start_page = make_normal_page_url("Main_Page"s);
-
-std::set<std::string> mediawiki_pages;
-auto forbidden_pages = []() {
-    std::set<std::string> fp;
-    fp.insert("Special:"s);
-    fp.insert("Template_talk:"s);
-    fp.insert("Cppreference:"s);
-    fp.insert("Talk:"s);
-    fp.insert("Category:"s);
-    fp.insert("File:"s);
-    fp.insert("MediaWiki:"s);
-    fp.insert("User:"s);
-    fp.insert("ftp:"s);
-    fp.insert("javascript:"s);
-    return fp;
-}();
-
-auto download_url(auto &&url) {
-    return cache().find<url_request_cache>(url, [&]() {
-        std::osyncstream{ std::cout } << std::format("downloading {}\n", url);
-
-        HttpRequest req{ httpSettings };
-        req.url = url;
-        req.timeout = 90;
-        auto resp = url_request(req);
-        if (resp.http_code != 200) {
-            throw std::runtime_error{ std::format("url = {}, http code = {}", url, resp.http_code) };
+// streams stored page names (with their html) or wikitext titles (with their source) matching a glob pattern,
+// in key order. f(key, body, hash) gets lazy getters: only the pages it asks for are read and decompressed,
+// hash() is the sha256 of the body and comes from the store index without loading it
+void for_each_stored(snapshot_pack::kind k, const std::string &pattern, auto &&f) {
+    if (pack()) {
+        for (auto &&e : pack()->range(k, glob_prefix(pattern))) {
+            if (glob_match(pattern, pack()->key(e))) {
+                f(pack()->key(e), [&] { return pack()->body(e); }, [&] { return std::string{pack()->hash(e)}; });
+            }
         }
-        return resp.response;
+        return;
+    }
+    auto st = store();
+    if (k == snapshot_pack::wikitext) {
+        st.scan("wikitext", "name", "text", pattern, [&](auto key, auto &&text) {
+            std::string body;
+            auto get_body = [&] {
+                if (body.empty()) {
+                    body = codec().decompress(std::string{text()});
+                }
+                return std::string_view{body};
+            };
+            f(key, get_body, [&] { return sha256(std::string{get_body()}); });
+        });
+        return;
+    }
+    st.scan("page_name", "name", "hash", pattern, [&](auto key, auto &&hash) {
+        page_store::body body;
+        f(key, [&] {
+            body = st.find_hash(std::string{hash()});
+            return body ? std::string_view{*body} : ""sv;
+        }, [&] { return std::string{hash()}; });
     });
 }
+// writes only when the content differs, so unchanged outputs keep their mtime and do not trigger rebuilds
+bool write_file_if_changed(const path &fn, const std::string &s) {
+    std::error_code ec;
+    if (fs::file_size(fn, ec) == s.size() && !ec && read_file(fn) == s) {
+        return false;
+    }
+    write_file(fn, s);
+    return true;
+}
+// page name -> sha256 of its stored source and of the header generated from it.
+// A page whose source is unchanged since a run of the same generator version and whose header
+// is still the generated one is not converted again; a hand edited or deleted header is regenerated
+struct generation_manifest {
+    static inline constexpr int generator_version = 2; // bump on any change of the generated code
+
+    struct entry {
+        std::string key; // store key the page came from, matched against --pages when pruning
+        std::string source;
+        std::string output;
+    };
 
-struct page {
-    std::string url;
-    std::string source;
-    std::set<std::string> links;
+    path fn;
+    std::map<std::string, entry> pages;
+    std::mutex m;
 
-    page() = default;
-    page(const std::string &url) : url{url} {
-        source = download_url(url);
-        parse_links();
-    }
-    bool is_c_page() const {
-        return url.contains("/w/c/"sv) || url.ends_with("/w/c"sv);
-    }
-    bool is_cpp_page() const {
-        return url.contains("/w/cpp/"sv) || url.ends_with("/w/cpp"sv);
+    generation_manifest(const path &fn) : fn{fn} {
+        if (!fs::exists(fn)) {
+            return;
+        }
+        auto j = nlohmann::json::parse(read_file(fn));
+        if (j["version"].get<int>() != generator_version) {
+            return;
+        }
+        for (auto &&[name, e] : j["pages"].items()) {
+            pages[name] = { e["key"].get<std::string>(), e["source"].get<std::string>(), e["output"].get<std::string>() };
+        }
     }
-    void parse_links() {
-        primitives::html::root r{source};
-        for (auto &&n : r | std::views::filter([](auto &&n){return n.is("a"sv) && n.has("href"sv);})) {
-            auto a = n.attribute("href");
-            std::string l{*a};
-            if (l.starts_with("http"sv) || l.contains(".php"sv) || l.contains("javascript:"sv)) {
-                continue;
-            }
-            l = l.substr(0, l.find('#')); // take everything before '#'
-            l = l.substr(0, l.find('?')); // take everything before '?'
-            if (l.starts_with('/')) {
-                l = l.substr(1);
-                if (l.empty()) {
-                    continue;
-                }
-                links.insert(l); // we must parse everything because template pages are not fully connected
-                links.insert(make_edit_page_url(l));
-                continue;
-            }
-            if (l.empty()) {
-                continue;
-            }
-            path u{url};
-            if (!l.starts_with("http"sv) && !l.starts_with("../"sv)) {
-                u = u.parent_path();
-            }
-            if (l.starts_with("../"sv)) {
-                u = u.parent_path();
-            }
-            path p = u / l;
-            p = normalize_path(p);
-            p = p.lexically_normal();
-            p = normalize_path(p);
-            l = p.string();
-            if (auto p = l.find("http"sv); p != -1)
-                l = l.substr(p);
-            if (l.starts_with("https:/"sv)) {
-                l = "https://" + l.substr(7);
+    bool unchanged(const std::string &name, const std::string &source_hash, const path &output) {
+        std::string output_hash;
+        {
+            std::unique_lock lk{m};
+            auto i = pages.find(name);
+            if (i == pages.end() || i->second.source != source_hash) {
+                return false;
             }
-            links.insert(l);
+            output_hash = i->second.output;
         }
+        return fs::exists(output) && sha256(read_file(output)) == output_hash;
     }
-};
-
-struct parser {
-    primitives::sqlite::sqlitemgr db{path{ mirror_root_dir } += ".db"};
-    //primitives::sqlite::sqlitemgr db{path{ mirror_root_dir } += "_03.2026.db"};
-    std::map<std::string, page> pages;
-    std::set<std::string> processed_pages; // including bad pages
-
-    parser() {
-        db.create_tables(::db::parser::schema{});
-        db.enable_wal();
-        db.set_busy_timeout(5s);
+    void set(const std::string &name, std::string key, std::string source_hash, std::string output_hash) {
+        std::unique_lock lk{m};
+        pages[name] = { std::move(key), std::move(source_hash), std::move(output_hash) };
     }
-    void start() {
-        Executor e{10};
-        std::mutex m;
-        std::set<std::string> pages_to_load;
-        pages_to_load.insert(start_page);
-        while (1) {
-            for (auto &&p : pages_to_load) {
-                e.push([&]() {
-                auto pp = parse_page(p, m);
-                if (pp.url.empty()) {
-                    return;
-                }
-                std::unique_lock lk{m};
-                pages.emplace(pp.url, pp);
-                processed_pages.insert(pp.url);
-                    });
-            }
-            e.wait();
-            decltype(pages_to_load) links;
-            for (auto &&p : pages_to_load) {
-                links.insert_range(pages[p].links);
-            }
-            std::erase_if(links, [&](auto &&t) {
-                auto mw = t.starts_with("MediaWiki:"sv);
-                if (mw) {
-                    mediawiki_pages.insert(t);
-                }
-                return processed_pages.contains(t)
-                    || std::ranges::any_of(forbidden_pages, [&](auto &fp){return t.contains(fp);})
-                    ;
-                });
-            pages_to_load = links;
-            if (pages_to_load.empty()) {
-                break;
-            }
-        }
+    // drops pages this run should have seen but did not, their sources are gone from the store
+    void prune(const std::string &pattern, const std::set<std::string> &seen) {
+        std::unique_lock lk{m};
+        std::erase_if(pages, [&](auto &&p) {
+            return glob_match(pattern, p.second.key) && !seen.contains(p.first);
+        });
     }
-    page parse_page(auto &&pagename, auto &&m) {
-        page p;
-        auto db_page_sel = db.select<::db::parser::schema::tables_::page, &::db::parser::schema::tables_::page::name>(pagename);
-        auto db_page_i = db_page_sel.begin();
-        if (db_page_i != db_page_sel.end()) {
-            p.url = make_normal_page_url(pagename);
-            auto &db_p = *db_page_i;
-            p.source = db_p.source;
-            p.parse_links();
-        } else {
-            try {
-                p = page{ make_normal_page_url(pagename) };
-                std::unique_lock lk{ m };
-                auto tr = db.scoped_transaction();
-                auto page_ins = db.prepared_insert < ::db::parser::schema::tables_::page, primitives::sqlite::db::or_ignore{} > ();
-                page_ins.insert({ .name = pagename, .source = p.source });
-            } catch (std::exception &e) {
-                std::cerr << e.what() << "\n";
-            }
+    void save() {
+        nlohmann::json j;
+        j["version"] = generator_version;
+        auto &p = j["pages"] = nlohmann::json::object();
+        for (auto &&[name, e] : pages) {
+            p[name] = { {"key", e.key}, {"source", e.source}, {"output", e.output} };
         }
-        return p;
+        write_file_if_changed(fn, j.dump(1) + "\n");
     }
 };
-
-void parse() {
-    parser p;
-    p.start();
+void export_pack(const path &fn) {
+    using tables = ::db::parser::schema::tables_;
+
+    auto st = store();
+    snapshot_pack::writer w{fn};
+    auto blob = [&](const std::string &hash) {
+        auto b = st.find_hash(hash);
+        return b ? *b : ""s;
+    };
+    for (auto &&n : st.db.select<tables::page_name>()) {
+        std::string hash = n.hash;
+        w.add(snapshot_pack::name, n.name, hash, [&] { return blob(hash); });
+    }
+    for (auto &&u : st.db.select<tables::page_url>()) {
+        std::string hash = u.hash;
+        w.add(snapshot_pack::url, u.url, hash, [&] { return blob(hash); });
+    }
+    for (auto &&t : st.db.select<tables::wikitext>()) {
+        auto text = codec().decompress(t.text);
+        w.add(snapshot_pack::wikitext, t.name, sha256(text), [&] { return text; });
+    }
+    w.finish();
+    std::println("packed {} entries, {} bodies, {} MB into {}", w.index.size(), w.written.size(), w.pos / 1024 / 1024, fn.string());
 }
 
+// find all templates in data dir
+// grep "=Template:\K.*(?=&)" -r . -o -P -h | sort | uniq
+
 // FIXME: use traverse and ignore ignored classes
 std::string extract_text3(auto &&n, const std::string &delim = ""s) {
     std::string s;
@@ -279,9 +196,10 @@ auto get_classes(auto &&n) {
 }
 
 struct html_page {
+    std::string source;
     primitives::html::root root;
 
-    html_page(const std::string &p) : root{p} {
+    html_page(std::string p) : source{std::move(p)}, root{source} {
     }
     static auto find_node(auto &&n, auto &&attrname, auto &&idname) {
         return n.find(attrname, idname);
@@ -596,247 +514,333 @@ struct cpp_traverser {
         int d;
         const primitives::html::node *n;
     };
+    enum class tag_type {
+        other,
+        text, // text node, empty name
+        heading, // h1-h6
+        div,
+        a,
+        span,
+        pre,
+        code,
+        tbody,
+        tr,
+        th,
+        td,
+#define PAGE_ELEMENT_TAG(tag, element, kind) tag,
+        PAGE_ELEMENT_TAGS(PAGE_ELEMENT_TAG)
+#undef PAGE_ELEMENT_TAG
+        count_,
+    };
+    using class_set = std::bitset<256>; // known_classes() entry indices
+    // a node is classified once, then states and handlers test enum values and bits
+    struct node_info {
+        tag_type tag{};
+        class_set classes;
+        int first_class{-1}; // first known class in attribute order, it sets the node state
+        bool has_class_attr{};
+
+        bool has(const class_set &mask) const {
+            return (classes & mask).any();
+        }
+    };
 
     cpp_emitter &e;
     std::vector<state> st;
-    std::map<std::string, state_desc> known_classes;
+    int ignored{}; // states with action_type::ignore on the stack
+
+    // hashed at compile time, lookups do not allocate.
+    // Inside a function because state_desc initializers are usable only in complete class context
+    static const auto &known_classes() {
+        static constexpr perfect_hash_map m{std::to_array<std::pair<std::string_view, state_desc>>({
+            {"t-navbar"sv, {state_type::navbar}},
+            {"t-navbar-head"sv, {state_type::navbar_head}},
+            {"t-navbar-menu"sv, {state_type::navbar_menu}},
+            {"t-navbar-sep"sv, {state_type::navbar_sep}},
+            {"t-nv"sv, {state_type::navbar_menu_element}},
+            {"t-nv-begin"sv, {state_type::navbar_menu_elements_begin}},
+            {"t-nv-h1"sv, {state_type::navbar_menu_element_header1}},
+            {"t-nv-h2"sv, {state_type::navbar_menu_element_header2}},
+            {"t-nv-col-table"sv, {state_type::navbar_menu_element_column_table}},
+            {"t-nv-ln-table"sv, {state_type::navbar_menu_element_inline_table}},
+
+            {"t-rev-begin"sv, {state_type::t_rev_begin}},
+            {"t-rev"sv, {state_type::revision}}, // double check
+            {"t-rev-inl"sv, {state_type::revision_inline}}, // double check
+            {"t-rev-inl-noborder"sv, {state_type::revision_inline_noborder}}, // double check
+            {"t-mark-rev"sv, {state_type::mark_revision}},
+            {"t-mark"sv, {state_type::mark_object_type}},
+
+            {"t-image"sv, {state_type::t_image}},
+            {"image"sv, {state_type::image}},
+
+            {"t-dsc-small"sv, {state_type::small_text}},
+
+            // begin description table
+            {"t-dsc-begin"sv, {state_type::t_dsc_begin}},
+            {"t-dsc-header"sv, {state_type::t_dsc_header}},
+            {"t-dsc"sv, {state_type::t_dsc}},
+            {"t-dsc-member-div"sv, {state_type::t_dsc_member_div}},
+            {"t-dsc-hitem"sv, {}},
+            {"t-dsc-named-req-div"sv, {}},
+            {"t-dsc-see"sv, {}},
+            {"t-dsc-see-tt"sv, {}},
+            {"t-dsc-sep"sv, {}},
+
+            {"t-dcl-begin"sv, {state_type::t_dcl_begin}},
+            {"t-dcl"sv, {state_type::t_dcl}},
+            {"t-dcl-nopad"sv, {state_type::t_dcl_nopad}},
+            {"t-dcl-sep"sv, {state_type::t_dcl_sep}},
+            {"t-dcl-h"sv, {state_type::t_dcl_h}},
+            {"t-dcl-rev"sv, {}},
+            {"t-dcl-rev-aux"sv, {}},
+
+            {"noprint"sv, {state_type::noprint, action_type::ignore}},
+            {"toc"sv, {state_type::noprint, action_type::ignore}},
+            {"editsection"sv, {state_type::editsection, action_type::ignore}},
+            {"selflink"sv, {state_type::selflink}},
+            {"mw-headline"sv, {state_type::mw_headline}},
+            {"wikitable"sv, {state_type::wikitable}},
+            {"dsctable"sv, {state_type::dsctable}},
+
+            {"t-lines"sv, {state_type::lines}},
+
+            {"t-example"sv, {state_type::example}},
+            {"t-example-live-link"sv, {state_type::example_live_link}},
+
+            {"mw-geshi"sv, {state_type::mw_geshi}},
+            {"source-cpp"sv, {state_type::source_cpp}},
+
+            {"ambox"sv, {state_type::ambox}},
+            {"mbox-empty-cell"sv, {state_type::mbox_empty_cell}},
+            {"mbox-text"sv, {state_type::mbox_text}},
+
+            {"t-lc"sv, {state_type::lc}},
+
+            // ignored stuff
+            {"external"sv, {}},
+            {"t-inheritance-diagram"sv, {state_type::ignore, action_type::ignore}},
+            //parse_navbar(p, n);
+
+            {"t-ref-std-c++98"sv, {state_type::t_ref_std_cpp_98}},
+            {"t-ref-std-c++03"sv, {state_type::t_ref_std_cpp_03}},
+            {"t-ref-std-c++11"sv, {state_type::t_ref_std_cpp_11}},
+            {"t-ref-std-c++14"sv, {state_type::t_ref_std_cpp_14}},
+            {"t-ref-std-c++17"sv, {state_type::t_ref_std_cpp_17}},
+            {"t-ref-std-c++20"sv, {state_type::t_ref_std_cpp_20}},
+            {"t-ref-std-c++23"sv, {state_type::t_ref_std_cpp_23}},
+            {"t-ref-std-c++26"sv, {state_type::t_ref_std_cpp_26}},
+            {"t-ref-std-c++29"sv, {state_type::t_ref_std_cpp_29}},
+
+            {"t-since-cxx11"sv, {state_type::t_since_cpp11}},
+            {"t-since-cxx14"sv, {state_type::t_since_cpp14}},
+            {"t-since-cxx17"sv, {state_type::t_since_cpp17}},
+            {"t-since-cxx20"sv, {state_type::t_since_cpp20}},
+            {"t-since-cxx23"sv, {state_type::t_since_cpp23}},
+            {"t-since-cxx26"sv, {state_type::t_since_cpp26}},
+
+            {"t-until-cxx11"sv, {state_type::t_until_cpp11}},
+            {"t-until-cxx14"sv, {state_type::t_until_cpp14}},
+            {"t-until-cxx17"sv, {state_type::t_until_cpp17}},
+            {"t-until-cxx20"sv, {state_type::t_until_cpp20}},
+            {"t-until-cxx23"sv, {state_type::t_until_cpp23}},
+            {"t-until-cxx26"sv, {state_type::t_until_cpp26}},
+
+            {"t-since-c95"sv, {state_type::t_since_c95}},
+            {"t-since-c99"sv, {state_type::t_since_c99}},
+            {"t-since-c11"sv, {state_type::t_since_c11}},
+            {"t-since-c17"sv, {state_type::t_since_c17}},
+            {"t-since-c23"sv, {state_type::t_since_c23}},
+
+            {"t-until-c95"sv, {state_type::t_until_c95}},
+            {"t-until-c99"sv, {state_type::t_until_c99}},
+            {"t-until-c11"sv, {state_type::t_until_c11}},
+            {"t-until-c17"sv, {state_type::t_until_c17}},
+            {"t-until-c23"sv, {state_type::t_until_c23}},
+
+            {"t-ref-std-c89"sv, {state_type::t_ref_std_c89}},
+            {"t-ref-std-c99"sv, {state_type::t_ref_std_c99}},
+            {"t-ref-std-11"sv, {state_type::t_ref_std_11}},
+            {"t-ref-std-17"sv, {state_type::t_ref_std_17}},
+            {"t-ref-std-23"sv, {state_type::t_ref_std_23}},
+
+            {"table-yes"sv, {state_type::table_yes}},
+            {"table-no"sv, {state_type::table_no}},
+            {"table-maybe"sv, {state_type::table_maybe}},
+            {"table-na"sv, {state_type::table_na}},
+
+            // TODO:
+
+            // lists?
+            {"t-li"sv, {}},
+            {"t-li1"sv, {}},
+            {"t-li2"sv, {}},
+            {"t-li3"sv, {}},
+
+            {"t-sdsc-begin"sv, {}},
+            {"t-sdsc"sv, {}},
+            {"t-sdsc-nopad"sv, {}},
+            {"t-sdsc-sep"sv, {}},
+
+            {"t-par-begin"sv, {}},
+            {"t-par"sv, {}},
+            {"t-par-req"sv, {}},
+            {"t-par-hitem"sv, {}},
+
+            {"t-plot"sv, {}},
+            {"t-plot-bottom"sv, {}},
+            {"t-plot-image-left"sv, {}},
+            {"t-plot-image-left-right"sv, {}},
+            {"t-plot-left"sv, {}},
+            {"t-plot-right"sv, {}},
+
+            {"t-noexcept-box"sv, {}},
+            {"t-noexcept-full"sv, {}},
+            {"t-noexcept-inline"sv, {}},
+
+            {"t-page-template"sv, {}},
+            {"t-nv-ln-named-req-table"sv, {}},
+            {"t-su"sv, {}},
+            {"t-v"sv, {}},
+            {"t-vertical"sv, {}},
+
+            {"t-mrad"sv, {}},
+            {"t-mfrac"sv, {}},
+            {"t-mparen"sv, {}},
+            {"t-inherited"sv, {}},
+            {"t-member"sv, {}},
+            {"t-spar"sv, {}},
+
+            {"t-c"sv, {}},
+            {"t-cmark"sv, {}},
+            {"t-cc"sv, {}},
+
+            // footnotes
+            {"reference"sv, {}},
+            {"reference-text"sv, {}},
+            {"references"sv, {}},
+
+            {"mw-collapsible"sv, {}},
+            {"mw-collapsible-content"sv, {}},
+            {"mw-redirect"sv, {}},
+            {"mw-cite-backlink"sv, {}},
+
+            {"texhtml"sv, {}},
+            {"new"sv, {}},
+            {"row"sv, {}},
+            {"spacer"sv, {}},
+            {"plainlinks"sv, {}},
+            {"mainpagediv"sv, {}},
+            {"mainpagetable"sv, {}},
+            {"div-col"sv, {}},
+            {"extiw"sv, {}},
+            {"eq-fun-cpp-table"sv, {}},
+            {"citation"sv, {}},
+            {"t-template"sv, {}},
+            {"t-template-editlink"sv, {}},
+
+            {"mbox-image"sv, {}},
+
+            // math tex (formulas)
+            {"mjax"sv, {}},
+            {"mjax-fallback"sv, {}},
+
+            {"coliru-btn"sv, {}},
+
+            // geshi highlighting, numbered families share one entry (see class_key())
+            {"kw"sv, {}},
+            {"sy"sv, {}},
+            {"br"sv, {}},
+            {"me"sv, {}},
+            {"st"sv, {}},
+            {"nu"sv, {}},
+            {"es"sv, {}},
+            {"co"sv, {}},
+            {"coMULTI"sv, {}},
+        })};
+        static_assert(m.size() <= class_set{}.size());
+        return m;
+    }
+    static const auto &known_tags() {
+        static constexpr perfect_hash_map m{std::to_array<std::pair<std::string_view, tag_type>>({
+            {""sv, tag_type::text},
+            {"h1"sv, tag_type::heading},
+            {"h2"sv, tag_type::heading},
+            {"h3"sv, tag_type::heading},
+            {"h4"sv, tag_type::heading},
+            {"h5"sv, tag_type::heading},
+            {"h6"sv, tag_type::heading},
+            {"div"sv, tag_type::div},
+            {"a"sv, tag_type::a},
+            {"span"sv, tag_type::span},
+            {"pre"sv, tag_type::pre},
+            {"code"sv, tag_type::code},
+            {"tbody"sv, tag_type::tbody},
+            {"tr"sv, tag_type::tr},
+            {"th"sv, tag_type::th},
+            {"td"sv, tag_type::td},
+#define PAGE_ELEMENT_TAG(tag, element, kind) {std::string_view{#tag}, tag_type::tag},
+            PAGE_ELEMENT_TAGS(PAGE_ELEMENT_TAG)
+#undef PAGE_ELEMENT_TAG
+        })};
+        return m;
+    }
+    static class_set class_mask(std::initializer_list<std::string_view> names) {
+        class_set s;
+        for (auto &&c : names) {
+            auto i = known_classes().index_of(c);
+            if (i < 0) {
+                throw std::logic_error{std::format("unknown class: {}", c)};
+            }
+            s.set(i);
+        }
+        return s;
+    }
+    // geshi classes are a family name and a number: kw1, sy0, br0, coMULTI...
+    static std::string_view class_key(std::string_view c) {
+        return c.size() > 2 && isdigit((unsigned char)c[2]) ? c.substr(0, 2) : c;
+    }
 
     cpp_traverser(cpp_emitter &e) : e{e} {
-        {
-        known_classes["t-navbar"] = {state_type::navbar};
-        known_classes["t-navbar-head"] = {state_type::navbar_head};
-        known_classes["t-navbar-menu"] = {state_type::navbar_menu};
-        known_classes["t-navbar-sep"] = {state_type::navbar_sep};
-        known_classes["t-nv"] = {state_type::navbar_menu_element};
-        known_classes["t-nv-begin"] = {state_type::navbar_menu_elements_begin};
-        known_classes["t-nv-h1"] = {state_type::navbar_menu_element_header1};
-        known_classes["t-nv-h2"] = {state_type::navbar_menu_element_header2};
-        known_classes["t-nv-col-table"] = {state_type::navbar_menu_element_column_table};
-        known_classes["t-nv-ln-table"] = {state_type::navbar_menu_element_inline_table};
-
-        known_classes["t-rev-begin"] = { state_type::t_rev_begin };
-        known_classes["t-rev"] = {state_type::revision}; // double check
-        known_classes["t-rev-inl"] = {state_type::revision_inline}; // double check
-        known_classes["t-rev-inl-noborder"] = {state_type::revision_inline_noborder}; // double check
-        known_classes["t-mark-rev"] = {state_type::mark_revision};
-        known_classes["t-mark"] = {state_type::mark_object_type};
-
-        known_classes["t-image"] = {state_type::t_image};
-        known_classes["image"] = {state_type::image};
-
-        known_classes["t-dsc-small"] = {state_type::small_text};
-
-        // begin description table
-        known_classes["t-dsc-begin"] = {state_type::t_dsc_begin};
-        known_classes["t-dsc-header"] = {state_type::t_dsc_header};
-        known_classes["t-dsc"] = {state_type::t_dsc};
-        known_classes["t-dsc-member-div"] = {state_type::t_dsc_member_div};
-        known_classes["t-dsc-hitem"] = {};
-        known_classes["t-dsc-named-req-div"] = {};
-        known_classes["t-dsc-see"] = {};
-        known_classes["t-dsc-see-tt"] = {};
-        known_classes["t-dsc-sep"] = {};
-
-        known_classes["t-dcl-begin"] = { state_type::t_dcl_begin };
-        known_classes["t-dcl"] = { state_type::t_dcl };
-        known_classes["t-dcl-nopad"] = { state_type::t_dcl_nopad };
-        known_classes["t-dcl-sep"] = { state_type::t_dcl_sep };
-        known_classes["t-dcl-h"] = { state_type::t_dcl_h };
-        known_classes["t-dcl-rev"] = {};
-        known_classes["t-dcl-rev-aux"] = {};
-
-        known_classes["noprint"] = {state_type::noprint, action_type::ignore};
-        known_classes["toc"] = { state_type::noprint, action_type::ignore };
-        known_classes["editsection"] = { state_type::editsection, action_type::ignore };
-        known_classes["selflink"] = { state_type::selflink };
-        known_classes["mw-headline"] = { state_type::mw_headline };
-        known_classes["wikitable"] = { state_type::wikitable };
-        known_classes["dsctable"] = { state_type::dsctable };
-
-        known_classes["t-lines"] = { state_type::lines };
-
-        known_classes["t-example"] = { state_type::example };
-        known_classes["t-example-live-link"] = { state_type::example_live_link };
-
-        known_classes["mw-geshi"] = { state_type::mw_geshi };
-        known_classes["source-cpp"] = { state_type::source_cpp };
-
-        known_classes["ambox"] = { state_type::ambox };
-        known_classes["mbox-empty-cell"] = { state_type::mbox_empty_cell };
-        known_classes["mbox-text"] = { state_type::mbox_text };
-
-        known_classes["t-lc"] = { state_type::lc };
-
-        // ignored stuff
-        known_classes["external"] = {};
-        known_classes["t-inheritance-diagram"] = { state_type::ignore, action_type::ignore };
-        //parse_navbar(p, n);
-
-        known_classes["t-ref-std-c++98"] = { state_type::t_ref_std_cpp_98 };
-        known_classes["t-ref-std-c++03"] = { state_type::t_ref_std_cpp_03 };
-        known_classes["t-ref-std-c++11"] = { state_type::t_ref_std_cpp_11 };
-        known_classes["t-ref-std-c++14"] = { state_type::t_ref_std_cpp_14 };
-        known_classes["t-ref-std-c++17"] = { state_type::t_ref_std_cpp_17 };
-        known_classes["t-ref-std-c++20"] = { state_type::t_ref_std_cpp_20 };
-        known_classes["t-ref-std-c++23"] = { state_type::t_ref_std_cpp_23 };
-        known_classes["t-ref-std-c++26"] = { state_type::t_ref_std_cpp_26 };
-        known_classes["t-ref-std-c++29"] = { state_type::t_ref_std_cpp_29 };
-
-        known_classes["t-since-cxx11"] = { state_type::t_since_cpp11 };
-        known_classes["t-since-cxx14"] = { state_type::t_since_cpp14 };
-        known_classes["t-since-cxx17"] = { state_type::t_since_cpp17 };
-        known_classes["t-since-cxx20"] = { state_type::t_since_cpp20 };
-        known_classes["t-since-cxx23"] = { state_type::t_since_cpp23 };
-        known_classes["t-since-cxx26"] = { state_type::t_since_cpp26 };
-
-        known_classes["t-until-cxx11"] = { state_type::t_until_cpp11 };
-        known_classes["t-until-cxx14"] = { state_type::t_until_cpp14 };
-        known_classes["t-until-cxx17"] = { state_type::t_until_cpp17 };
-        known_classes["t-until-cxx20"] = { state_type::t_until_cpp20 };
-        known_classes["t-until-cxx23"] = { state_type::t_until_cpp23 };
-        known_classes["t-until-cxx26"] = { state_type::t_until_cpp26 };
-
-        known_classes["t-since-c95"] = { state_type::t_since_c95 };
-        known_classes["t-since-c99"] = { state_type::t_since_c99 };
-        known_classes["t-since-c11"] = { state_type::t_since_c11 };
-        known_classes["t-since-c17"] = { state_type::t_since_c17 };
-        known_classes["t-since-c23"] = { state_type::t_since_c23 };
-
-        known_classes["t-until-c95"] = { state_type::t_until_c95 };
-        known_classes["t-until-c99"] = { state_type::t_until_c99 };
-        known_classes["t-until-c11"] = { state_type::t_until_c11 };
-        known_classes["t-until-c17"] = { state_type::t_until_c17 };
-        known_classes["t-until-c23"] = { state_type::t_until_c23 };
-
-        known_classes["t-ref-std-c89"] = { state_type::t_ref_std_c89 };
-        known_classes["t-ref-std-c99"] = { state_type::t_ref_std_c99 };
-        known_classes["t-ref-std-11"] = { state_type::t_ref_std_11 };
-        known_classes["t-ref-std-17"] = { state_type::t_ref_std_17 };
-        known_classes["t-ref-std-23"] = { state_type::t_ref_std_23 };
-
-        known_classes["table-yes"] = { state_type::table_yes };
-        known_classes["table-no"] = { state_type::table_no };
-        known_classes["table-maybe"] = { state_type::table_maybe };
-        known_classes["table-na"] = { state_type::table_na };
-
-        // TODO:
-
-        // lists?
-        known_classes["t-li"] = {};
-        known_classes["t-li1"] = {};
-        known_classes["t-li2"] = {};
-        known_classes["t-li3"] = {};
-
-        known_classes["t-sdsc-begin"] = {};
-        known_classes["t-sdsc"] = {};
-        known_classes["t-sdsc-nopad"] = {};
-        known_classes["t-sdsc-sep"] = {};
-
-        known_classes["t-par-begin"] = {};
-        known_classes["t-par"] = {};
-        known_classes["t-par-req"] = {};
-        known_classes["t-par-hitem"] = {};
-
-        known_classes["t-plot"] = {};
-        known_classes["t-plot-bottom"] = {};
-        known_classes["t-plot-image-left"] = {};
-        known_classes["t-plot-image-left-right"] = {};
-        known_classes["t-plot-left"] = {};
-        known_classes["t-plot-right"] = {};
-
-        known_classes["t-noexcept-box"] = {};
-        known_classes["t-noexcept-full"] = {};
-        known_classes["t-noexcept-inline"] = {};
-
-        known_classes["t-page-template"] = {};
-        known_classes["t-nv-ln-named-req-table"] = {};
-        known_classes["t-su"] = {};
-        known_classes["t-v"] = {};
-        known_classes["t-vertical"] = {};
-
-        known_classes["t-mrad"] = {};
-        known_classes["t-mfrac"] = {};
-        known_classes["t-mparen"] = {};
-        known_classes["t-inherited"] = {};
-        known_classes["t-member"] = {};
-        known_classes["t-spar"] = {};
-
-        known_classes["t-c"] = {};
-        known_classes["t-cmark"] = {};
-        known_classes["t-cc"] = {};
-
-        // footnotes
-        known_classes["reference"] = {};
-        known_classes["reference-text"] = {};
-        known_classes["references"] = {};
-
-        known_classes["mw-collapsible"] = {};
-        known_classes["mw-collapsible-content"] = {};
-        known_classes["mw-redirect"] = {};
-        known_classes["mw-cite-backlink"] = {};
-
-        known_classes["texhtml"] = {};
-        known_classes["new"] = {};
-        known_classes["row"] = {};
-        known_classes["spacer"] = {};
-        known_classes["plainlinks"] = {};
-        known_classes["mainpagediv"] = {};
-        known_classes["mainpagetable"] = {};
-        known_classes["div-col"] = {};
-        known_classes["extiw"] = {};
-        known_classes["eq-fun-cpp-table"] = {};
-        known_classes["citation"] = {};
-        known_classes["t-template"] = {};
-        known_classes["t-template-editlink"] = {};
-
-        known_classes["mbox-image"] = {};
-
-        // math tex (formulas)
-        known_classes["mjax"] = {};
-        known_classes["mjax-fallback"] = {};
-
-        known_classes["coliru-btn"] = {};
-        }
     }
 
     void pop_state(int depth) {
         while (!st.empty() && st.back().d >= depth) {
+            ignored -= st.back().a == action_type::ignore;
             st.pop_back();
         }
     }
+    void push_state(const state_desc &d, int depth, const primitives::html::node &n) {
+        ignored += d.a == action_type::ignore;
+        st.push_back({ d, depth, &n });
+    }
     bool is_ignored() const {
-        return std::ranges::any_of(st, [](auto &&st){return st.a == action_type::ignore;});
+        return ignored > 0;
     }
-    bool check_classes(const primitives::html::node &n, int depth) {
+    static node_info classify(const primitives::html::node &n) {
+        node_info info;
+        if (auto t = known_tags().find(n.name())) {
+            info.tag = *t;
+        }
         auto cl = n.attribute_or_default("class");
+        info.has_class_attr = !cl.empty();
         for (auto &&i : std::views::split(cl, " "sv)) {
-            std::string_view c{i};
-            auto kci = known_classes.find(std::string{ c });
-            auto r = kci != known_classes.end();
-            auto is_kw0 = [&](auto &&sv){return c.starts_with(sv) && c.size() > 2 && isdigit(c[2]);};
-            auto is_kw = is_kw0("kw"sv);
-            auto is_sy = is_kw0("sy"sv);
-            auto is_br = is_kw0("br"sv);
-            if (false
-                || is_kw0("kw"sv)
-                || is_kw0("sy"sv)
-                || is_kw0("br"sv)
-                || is_kw0("me"sv)
-                || is_kw0("st"sv)
-                || is_kw0("nu"sv)
-                || is_kw0("es"sv)
-                || is_kw0("co"sv)
-                || c.starts_with("coMULTI"sv)
-                ) {
-                return true;
-            }
-            if (r) {
-                st.push_back({ kci->second, depth, &n });
-                return r;
+            if (auto id = known_classes().index_of(class_key(std::string_view{i})); id >= 0) {
+                info.classes.set(id);
+                if (info.first_class < 0) {
+                    info.first_class = id;
+                }
             }
         }
-        if (!cl.empty()) {
-            std::println("unk class: {}", cl);
+        return info;
+    }
+    bool check_classes(const primitives::html::node &n, const node_info &info, int depth) {
+        if (info.first_class >= 0) {
+            push_state(known_classes().entries[info.first_class].second, depth, n);
+            return true;
+        }
+        if (info.has_class_attr) {
+            std::println("unk class: {}", n.attribute_or_default("class"));
             return false;
         }
         return true;
@@ -848,228 +852,190 @@ struct cpp_traverser {
         using enum primitives::html::node::traverse_action;
 
         pop_state(depth);
-        if (!check_classes(n, depth) || is_ignored()) {
+        auto info = classify(n);
+        if (!check_classes(n, info, depth) || is_ignored()) {
             return skip_children;
         }
+        return (this->*tag_handlers()[(size_t)info.tag].f)(n, info);
+    }
 
-        struct scope_tag {
-            cpp_emitter &e;
-            std::string type_name;
+    using traverse_action = primitives::html::node::traverse_action;
+    using tag_handler = traverse_action (cpp_traverser::*)(const primitives::html::node &, const node_info &);
+    struct tag_desc {
+        tag_handler f{&cpp_traverser::on_unhandled};
+        std::string_view element; // for on_element
+        page_elements::element_kind kind{};
+    };
+    // indexed by tag_type, the PAGE_ELEMENT_TAGS ones share on_element
+    static const std::array<tag_desc, (size_t)tag_type::count_> &tag_handlers() {
+        static const auto t = [] {
+            std::array<tag_desc, (size_t)tag_type::count_> t;
+            auto set = [&](tag_type tag, tag_handler f) {
+                t[(size_t)tag].f = f;
+            };
+            set(tag_type::text, &cpp_traverser::on_text);
+            set(tag_type::heading, &cpp_traverser::on_heading);
+            set(tag_type::div, &cpp_traverser::on_div);
+            set(tag_type::a, &cpp_traverser::on_a);
+            set(tag_type::span, &cpp_traverser::on_span);
+            set(tag_type::pre, &cpp_traverser::on_pre);
+            set(tag_type::code, &cpp_traverser::on_code);
+            set(tag_type::tbody, &cpp_traverser::on_tbody);
+            set(tag_type::tr, &cpp_traverser::on_row);
+            set(tag_type::th, &cpp_traverser::on_col);
+            set(tag_type::td, &cpp_traverser::on_col);
+#define PAGE_ELEMENT_TAG(tag, element, kind) \
+            t[(size_t)tag_type::tag] = {&cpp_traverser::on_element, std::string_view{#element}, page_elements::element_kind::kind};
+            PAGE_ELEMENT_TAGS(PAGE_ELEMENT_TAG)
+#undef PAGE_ELEMENT_TAG
+            return t;
+        }();
+        return t;
+    }
 
-            scope_tag(cpp_emitter &e, std::string_view tag) : e{ e }, type_name{ tag } {
-                e.add_type(std::format("{}{{}}", type_name));
-            }
-            ~scope_tag() {
-                e.add_type(std::format("{}_end{{}}", type_name));
-            }
-        };
-        struct scoped_as_is {
-            cpp_emitter &e;
-            std::string tag;
+    struct scope_tag {
+        cpp_emitter &e;
+        std::string type_name;
 
-            scoped_as_is(cpp_emitter &e, const primitives::html::node &n) : e{ e } {
-                tag = n.tag();
-                e.add_text(std::format("{}", n.tag_raw()));
-            }
-            ~scoped_as_is() {
-                e.add_text(std::format("</{}>", tag));
-            }
-        };
+        scope_tag(cpp_emitter &e, std::string_view tag) : e{ e }, type_name{ tag } {
+            e.add_type(std::format("{}{{}}", type_name));
+        }
+        ~scope_tag() {
+            e.add_type(std::format("{}_end{{}}", type_name));
+        }
+    };
+    struct scoped_as_is {
+        cpp_emitter &e;
+        std::string tag;
 
-        auto cl = n.attribute_or_default("class"sv);
-        auto has_class = [&](auto &&c) {
-            auto p = cl.find(c);
-            if (p != -1) {
-                if ((p == 0 || cl[p - 1] == ' ') && (cl.size() == p + c.size() || cl[p + c.size()] == ' ')) {
-                    return true;
-                }
-            }
-            return false;
-            };
-        auto has_classes = [&](auto &&...c) {
-            return (false || ... || has_class(c));
-            };
-        auto get_int_attr_val = [&](auto &&c) {
-            int i{};
-            if (auto v = n.attribute_or_default(c); !v.empty()) {
-                if (auto [_, ec] = std::from_chars(v.data(), v.data() + v.size(), i); ec != std::errc{}) {
-                    throw;
-                }
+        scoped_as_is(cpp_emitter &e, const primitives::html::node &n) : e{ e } {
+            tag = n.tag();
+            e.add_text(std::format("{}", n.tag_raw()));
+        }
+        ~scoped_as_is() {
+            e.add_text(std::format("</{}>", tag));
+        }
+    };
+    static int int_attribute(const primitives::html::node &n, std::string_view name) {
+        int i{};
+        if (auto v = n.attribute_or_default(name); !v.empty()) {
+            if (auto [_, ec] = std::from_chars(v.data(), v.data() + v.size(), i); ec != std::errc{}) {
+                throw;
             }
-            return i;
-            };
-        // get_classes(n);
+        }
+        return i;
+    }
 
-        std::string_view name = n.name();
-        if (0) {
-        } else if (n.is("div"sv)) {
-            if (false) {
-            } else if (cl.contains("t-navbar"sv)) {
-            } else if (cl.contains("t-template-editlink"sv)) {
-                e.add_type("template_{}"sv);
-                traverse(n);
-            } else if (cl.contains("t-dsc-member-div"sv)) {
-                scoped_as_is sc{e,n};
-                for (auto &&c : n.children) {
-                    scoped_as_is sc{ e,*c };
-                    traverse(*c);
-                }
-            } else if (cl.contains("mw-geshi"sv)) {
-                scope_tag t{e, "code"};
-                e.add_text(extract_text3(n));
-            } else {
-                traverse(n);
-            }
-            return skip_children;
-        } else if (name.size() == 2 && name[0] == 'h') {
-            e.add_header(name[1] - '0');
+    traverse_action on_element(const primitives::html::node &n, const node_info &info) {
+        using enum page_elements::element_kind;
+        auto &d = tag_handlers()[(size_t)info.tag];
+        e.add_type("{}{{}}"sv, d.element);
+        if (d.kind != leaf) {
             traverse(n);
-            e.add_type("header_end{}"sv);
+        }
+        if (d.kind == block) {
+            e.add_type("{}_end{{}}"sv, d.element);
             e.add_line();
-            return skip_children;
-        } else if (n.is("a"sv)) {
-            if (0) {
-            } else if (auto a = n.attribute_or_default("title"sv); !a.empty()) {
-                std::string v{a};
-                e.add_type("link{{\"{}\"}}"sv, boost::replace_all_copy(v, " "sv, "_"sv));
-            } else if (auto h = n.attribute_or_default("href"sv); !h.empty()) {
-                e.add_type("link{{\"{}\"}}"sv, h);
-            } else {
-                e.add_type("link{}"sv);
-            }
+        }
+        return traverse_action::skip_children;
+    }
+    traverse_action on_text(const primitives::html::node &n, const node_info &) {
+        e.add_text(n.text());
+        return traverse_action::skip_children;
+    }
+    traverse_action on_heading(const primitives::html::node &n, const node_info &) {
+        e.add_header(n.name()[1] - '0');
+        traverse(n);
+        e.add_type("header_end{}"sv);
+        e.add_line();
+        return traverse_action::skip_children;
+    }
+    traverse_action on_div(const primitives::html::node &n, const node_info &info) {
+        static const auto navbar = class_mask({"t-navbar"sv, "t-navbar-head"sv, "t-navbar-menu"sv, "t-navbar-sep"sv});
+        static const auto template_editlink = class_mask({"t-template-editlink"sv});
+        static const auto member_div = class_mask({"t-dsc-member-div"sv});
+        static const auto geshi = class_mask({"mw-geshi"sv});
+
+        if (false) {
+        } else if (info.has(navbar)) {
+        } else if (info.has(template_editlink)) {
+            e.add_type("template_{}"sv);
             traverse(n);
-            e.add_type("link_end{}"sv);
-            return skip_children;
-        } else if (n.is("span"sv)) {
-            if (has_classes("t-mark"sv, "t-mark-rev"sv)) {
-                e.add_text(extract_as_is(n));
-                return skip_children;
+        } else if (info.has(member_div)) {
+            scoped_as_is sc{e,n};
+            for (auto &&c : n.children) {
+                scoped_as_is sc{ e,*c };
+                traverse(*c);
             }
-            if (has_classes("t-lines"sv)) {
-                e.add_text(extract_as_is(n));
-                return skip_children;
-            }
-            if (cl.contains("mw-geshi"sv)) {
-                scope_tag t{ e, "code_tag" };
-                e.add_text(extract_text3(n));
-                return skip_children;
-            }
-            traverse(n);
-            return skip_children;
-        } else if (n.is("p"sv)) {
-            e.add_type("paragraph{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("pre"sv)) {
-            traverse(n);
-            return skip_children;
-        } else if (n.is("code"sv)) {
-            scope_tag t{ e, "code_tag" };
-            traverse(n);
-            return skip_children;
-        } else if (n.is("table"sv)) {
-            e.add_type("table{}"sv);
-            traverse(n);
-            e.add_type("table_end{}"sv);
-            e.add_line();
-            return skip_children;
-        } else if (n.is("tbody"sv)) {
-        } else if (n.is("tr"sv)) {
-            e.add_type("next_row{{{}}}"sv, get_int_attr_val("rowspan"sv));
-            traverse(n);
-            return skip_children;
-        } else if (n.is("th"sv)) {
-            e.add_type("next_col{{{}}}"sv, get_int_attr_val("colspan"sv));
-            traverse(n);
-            return skip_children;
-        } else if (n.is("td"sv)) {
-            e.add_type("next_col{{{}}}"sv, get_int_attr_val("colspan"sv));
-            traverse(n);
-            return skip_children;
-        } else if (n.is("cite"sv)) {
-            e.add_type("cite{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("b"sv)) {
-            e.add_type("bold{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("strong"sv)) {
-            e.add_type("bold{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("small"sv)) {
-            e.add_type("small{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("i"sv)) {
-            e.add_type("italic{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("tt"sv)) {
-            e.add_type("monospace{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("br"sv)) {
-            e.add_type("br{}"sv);
-            return skip_children;
-        } else if (n.is("abbr"sv)) {
-            e.add_type("abbr{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("ul"sv)) {
-            e.add_type("ul{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("ol"sv)) {
-            e.add_type("ol{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("li"sv)) {
-            e.add_type("li{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("dl"sv)) { // desc list
-            e.add_type("dl{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("dd"sv)) { // desc, def for dl
-            e.add_type("dd{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("dt"sv)) {
-            e.add_type("dt{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("blockquote"sv)) {
-            e.add_type("blockquote{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("img"sv)) {
-            e.add_type("img{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("caption"sv)) {
-            e.add_type("caption{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("sub"sv)) {
-            e.add_type("sub{}"sv);
-            traverse(n);
-            return skip_children;
-        } else if (n.is("sup"sv)) {
-            e.add_type("sup{}"sv);
+        } else if (info.has(geshi)) {
+            scope_tag t{e, "code"};
+            e.add_text(extract_text3(n));
+        } else {
             traverse(n);
-            return skip_children;
-        } else if (n.is(""sv)) {
-            e.add_text(n.text());
-            return skip_children;
+        }
+        return traverse_action::skip_children;
+    }
+    traverse_action on_a(const primitives::html::node &n, const node_info &) {
+        if (0) {
+        } else if (auto a = n.attribute_or_default("title"sv); !a.empty()) {
+            std::string v{a};
+            e.add_type("link{{\"{}\"}}"sv, boost::replace_all_copy(v, " "sv, "_"sv));
+        } else if (auto h = n.attribute_or_default("href"sv); !h.empty()) {
+            e.add_type("link{{\"{}\"}}"sv, h);
         } else {
-            std::println("unhandled tag: {}", name);
-            e.add_text(n.text());
-            return skip_children;
+            e.add_type("link{}"sv);
+        }
+        traverse(n);
+        e.add_type("link_end{}"sv);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_span(const primitives::html::node &n, const node_info &info) {
+        static const auto mark = class_mask({"t-mark"sv, "t-mark-rev"sv});
+        static const auto lines = class_mask({"t-lines"sv});
+        static const auto geshi = class_mask({"mw-geshi"sv});
+
+        if (info.has(mark)) {
+            e.add_text(extract_as_is(n));
+            return traverse_action::skip_children;
+        }
+        if (info.has(lines)) {
+            e.add_text(extract_as_is(n));
+            return traverse_action::skip_children;
+        }
+        if (info.has(geshi)) {
+            scope_tag t{ e, "code_tag" };
+            e.add_text(extract_text3(n));
+            return traverse_action::skip_children;
         }
-        return continue_;
+        traverse(n);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_pre(const primitives::html::node &n, const node_info &) {
+        traverse(n);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_code(const primitives::html::node &n, const node_info &) {
+        scope_tag t{ e, "code_tag" };
+        traverse(n);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_tbody(const primitives::html::node &n, const node_info &) {
+        return traverse_action::continue_;
+    }
+    traverse_action on_row(const primitives::html::node &n, const node_info &) {
+        e.add_type("next_row{{{}}}"sv, int_attribute(n, "rowspan"sv));
+        traverse(n);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_col(const primitives::html::node &n, const node_info &) {
+        e.add_type("next_col{{{}}}"sv, int_attribute(n, "colspan"sv));
+        traverse(n);
+        return traverse_action::skip_children;
+    }
+    traverse_action on_unhandled(const primitives::html::node &n, const node_info &) {
+        std::println("unhandled tag: {}", n.name());
+        e.add_text(n.text());
+        return traverse_action::skip_children;
     }
 };
 
@@ -1156,45 +1122,15 @@ struct processor {
         bool all_only{};
         //all_only = true;
         std::set<std::string> pages;
-        //primitives::sqlite::sqlitemgr db{ path{mirror_root_dir} += ".db" };
-        //for (auto &&db_p : db.select<::db::parser::schema::tables_::page>()) {
-        for (auto &&[p,db_p] : cache().get_all<url_request_cache>()) {
-            auto n = p;
-            if (n.starts_with("http")) {
-                auto w = "/w/"sv;
-                if (!n.contains(w)) {
-                    continue;
-                }
-                n = n.substr(n.find(w) + w.size());
-            }
-            if (n.ends_with(".html"s)) {
-                n = n.substr(0, n.size() - 5);
-            }
-            boost::replace_all(n, "%2522", "\"");
-            boost::replace_all(n, "%252A", "+");
-            if (1
-                && n != "Main_Page"sv
-                //&& n != "cpp/utility/format"sv
-                //&& n != "cpp/compiler_support"sv
-                //&& n != "c/numeric/math/NAN"sv
-                //&& n != "cpp/header/algorithm"sv
-                //&& n != "cpp/header/stdatomic.h"sv
-                //&& n != "cpp/utility/expected"sv
-                //&& n != "cpp/memory/new/operator_delete"sv
-                ) {
-                continue;
-            }
-
-            n = fix_name(n);
-
-            pages.insert(n);
-            if (!all_only) {
-                std::println("[{}] {}", pages.size(), n);
-            }
-
+        generation_manifest manifest{root / "manifest.json"};
+        auto header = [&](const std::string &n) {
+            path fn = n;
+            return root / (fn.parent_path() / fn.stem() += ".h");
+        };
+        auto convert = [&](const std::string &n, const std::string &key, std::string source, std::string source_hash) {
             auto ns = make_ns(n);
 
-            html_page page{ db_p };
+            html_page page{ std::move(source) };
 
             cpp_emitter page_emitter;
             page_emitter.begin_namespace(ns);
@@ -1219,11 +1155,108 @@ struct processor {
             page_emitter.end_function();
             page_emitter.end_namespace(ns);
 
-            path fn = n;
-            fn = fn.parent_path() / fn.stem() += ".h";
             if (!all_only) {
-                write_file(root / fn, page_emitter.get_text());
+                auto text = page_emitter.get_text();
+                write_file_if_changed(header(n), text);
+                manifest.set(n, key, std::move(source_hash), sha256(text));
             }
+        };
+
+        // pages are read in key order here and converted by the executor, each task with its own
+        // traverser and emitter. all.h and make_var() only see the sorted page set after the loop,
+        // so the output is the same for any --convert-jobs
+        std::mutex m;
+        std::condition_variable cv;
+        size_t in_flight{};
+        std::exception_ptr error;
+        auto max_in_flight = 2 * (size_t)std::max(1, (int)convert_jobs); // bounds sources held in memory
+        auto drain = [&] {
+            std::unique_lock lk{m};
+            cv.wait(lk, [&]{return in_flight == 0;});
+        };
+        // after the state its tasks use, so it goes first when unwinding
+        std::optional<Executor> ex;
+        if (convert_jobs > 1) {
+            ex.emplace((size_t)convert_jobs);
+        }
+
+        //primitives::sqlite::sqlitemgr db{ path{mirror_root_dir} += ".db" };
+        //for (auto &&db_p : db.select<::db::parser::schema::tables_::page>()) {
+        // e.g. --pages "cpp/utility/format", "cpp/header/*", "*"
+        try {
+            for_each_stored(snapshot_pack::name, convert_pages, [&](auto key, auto &&body, auto &&source_hash) {
+                if (key.starts_with("index.php"sv)) { // edit pages go to template_pages_to_cpp
+                    return;
+                }
+                // a task failed: stop feeding, the error is rethrown after the running tasks finish
+                if (ex) {
+                    std::unique_lock lk{m};
+                    if (error) {
+                        return;
+                    }
+                }
+                std::string n{key};
+                if (n.ends_with(".html"s)) {
+                    n = n.substr(0, n.size() - 5);
+                }
+                boost::replace_all(n, "%2522", "\"");
+                boost::replace_all(n, "%252A", "+");
+
+                n = fix_name(n);
+
+                // x and x.html, the first one in key order wins
+                if (!pages.insert(n).second) {
+                    return;
+                }
+                if (!all_only) {
+                    std::println("[{}] {}", pages.size(), n);
+                }
+
+                // same source and generator as last time, the header is still the generated one
+                auto hash = source_hash();
+                if (!all_only && manifest.unchanged(n, hash, header(n))) {
+                    return;
+                }
+
+                if (!ex) {
+                    convert(n, std::string{key}, std::string{body()}, std::move(hash));
+                    return;
+                }
+                std::string source{body()};
+                std::unique_lock lk{m};
+                cv.wait(lk, [&]{return in_flight < max_in_flight;});
+                if (error) { // failed while this body was read
+                    return;
+                }
+                ++in_flight;
+                lk.unlock();
+                ex->push([&, n, key = std::string{key}, source = std::move(source), hash = std::move(hash)]() mutable {
+                    std::exception_ptr e;
+                    try {
+                        convert(n, key, std::move(source), std::move(hash));
+                    } catch (...) {
+                        e = std::current_exception();
+                    }
+                    std::unique_lock lk{m};
+                    if (e && !error) {
+                        error = e;
+                    }
+                    --in_flight;
+                    cv.notify_all();
+                });
+            });
+        } catch (...) {
+            // reading the store failed, queued tasks still use the state above
+            drain();
+            throw;
+        }
+        drain();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if (!all_only) {
+            manifest.prune(convert_pages, pages);
+            manifest.save();
         }
 
         std::println("parsing done");
@@ -1247,7 +1280,18 @@ struct processor {
         }
         //headers.add_line();
 
-        write_file(root / "all.h", all.get_text());
+        auto all_text = all.get_text();
+        write_file_if_changed(root / "all.h", all_text);
+
+        // one hash of everything generated, compare it between --convert-jobs 1 and N runs
+        if (output_digest && !all_only) {
+            std::string digest;
+            for (auto &&n : pages) {
+                digest += n;
+                digest += sha256(read_file(header(n)));
+            }
+            std::println("output digest: {}", sha256(digest + sha256(all_text)));
+        }
     }
     void template_pages_to_cpp(const path &root) {
         std::println("parsing...");
@@ -1260,29 +1304,28 @@ struct processor {
         all.begin_block("struct " + struct_name + " {");
         auto &members = all.create_inline_emitter();
 
+        // --wikitext sources first, edit pages of older crawls fill the gaps
+        for_each_stored(snapshot_pack::wikitext, "*", [&](auto key, auto &&body, auto &&) {
+            auto &t = mw_templates[std::string{key}];
+            t.name = key;
+            t.body = body();
+        });
+
         std::set<std::string> pages;
-        for (auto &&[p, db_p] : cache().get_all<url_request_cache>()) {
-            auto n = p;
+        // '?' matches itself too
+        for_each_stored(snapshot_pack::name, "index.php?title=*&action=edit", [&](auto key, auto &&body, auto &&) {
+            std::string n{key};
             boost::replace_all(n, "%2522", "\"");
             boost::replace_all(n, "%252A", "+");
-            if (1
-                && (!n.contains("action=edit"))
-                //&& n != "cpp/utility/format"sv
-                //&& n != "cpp/compiler_support"sv
-                //&& n != "c/numeric/math/NAN"sv
-                //&& n != "cpp/header/algorithm"sv
-                //&& n != "cpp/header/stdatomic.h"sv
-                //&& n != "cpp/utility/expected"sv
-                //&& n != "cpp/memory/new/operator_delete"sv
-                ) {
-                continue;
-            }
-
 
             n = n.substr(0, n.find('&'));
             n = n.substr(n.find('=') + 1);
+            // wikitext keys are decoded titles
+            if (mw_templates.contains(percent_decode(n))) {
+                return;
+            }
 
-            html_page page{ db_p };
+            html_page page{ std::string{body()} };
 
             auto template_source = page.find_node("name", "wpTextbox1"); // or id= too
             if (!template_source) {
@@ -1292,7 +1335,7 @@ struct processor {
             auto &t = mw_templates[n];
             t.name = n;
             t.body = template_source->text();
-        }
+        });
 
         std::println("parsing done");
 
@@ -1309,10 +1352,10 @@ with ThreadPoolExecutor(max_workers=1) as executor:
 
             }
             auto fn = path{"generated"} / "mediawiki2" / fix_template_name_for_fs(t.name) += ".txt";
-            write_file(fn, t.body);
+            write_file_if_changed(fn, t.body);
             python_uploader += std::format("    executor.submit(make_page, {}, '{}', '{}')\n", ++n, t.name, normalize_path(fn).string());
         }
-        write_file("wikiapi_pages2.py", python_uploader);
+        write_file_if_changed("wikiapi_pages2.py", python_uploader);
         return;
 
         //
@@ -1365,10 +1408,30 @@ with ThreadPoolExecutor(max_workers=1) as executor:
 };
 
 int main(int argc, char *argv[]) {
-    path root_dir{ "generated/cpp" };
-    parse();
-    //pages_to_cpp(root_dir);
+    cl::ParseCommandLineOptions(argc, argv);
+    if (migrate_store) {
+        migrate_legacy_store();
+        return 0;
+    }
+    if (compress_db_opt) {
+        compress_db();
+        return 0;
+    }
+
+    if (!export_pack_file.empty()) {
+        export_pack(export_pack_file.getValue());
+        return 0;
+    }
+
+    path root_dir{ cpp_out.getValue() };
+    if (!pack() && !parse()) {
+        return 1;
+    }
     processor p;
-    p.template_pages_to_cpp(root_dir);
+    if (convert_cpp) {
+        p.pages_to_cpp(root_dir);
+    } else {
+        p.template_pages_to_cpp(root_dir);
+    }
     return 0;
 }
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+// crawl throughput benchmark, runs the real crawler against the local stand-in server
+//
+//   python standin_server.py --db cppreference.db --latency 50 --jitter 20 --error-rate 0.01
+//   crawl_bench --base-url http://127.0.0.1:8080 -j 10
+//
+// throttling server, the adaptive limit should settle around --max-concurrent:
+//
+//   python standin_server.py --db cppreference.db --latency 20 --max-concurrent 8
+//   crawl_bench -j 64
+//
+// handshake and compression cost, compare against the defaults (keep-alive, gzip):
+//
+//   python standin_server.py --db cppreference.db --latency 20 --identity --no-keep-alive
+//
+// without explicit --db it starts from an empty bench database (cold crawl),
+// pass an existing one to measure a warm re-crawl
+
+#include "crawler.h"
+
+#include <primitives/sw/main.h>
+
+#include <print>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+int main(int argc, char *argv[]) {
+    cl::ParseCommandLineOptions(argc, argv);
+
+    if (base_url.empty()) {
+        base_url = "http://127.0.0.1:8080"s;
+    }
+    if (!db_file.getNumOccurrences()) {
+        db_file = "crawl_bench.db"s;
+        for (auto &&suffix : {""s, "-wal"s, "-shm"s}) {
+            fs::remove(db_file.getValue() + suffix);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    parse();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::println("crawled {} pages from {} in {:.2f} s with {} workers", stats.pages.load(), base_url.getValue(), wall, (int)jobs);
+    std::println("  {:.1f} pages/s, {:.2f} MB/s ({} downloads, {} errors, {:.2f} MB)",
+        stats.pages / wall, stats.bytes / wall / 1024 / 1024,
+        stats.downloads.load(), stats.download_errors.load(), stats.bytes / 1024. / 1024);
+    std::println("  {:.2f} MB on the wire ({:.1f}x compression), {} connections for {} downloads",
+        stats.wire_bytes / 1024. / 1024, stats.wire_bytes ? (double)stats.bytes / stats.wire_bytes : 0.,
+        stats.connections.load(), stats.downloads.load());
+    std::println("  fetch latency p50 {:.1f} ms, p99 {:.1f} ms",
+        stats.fetch_latency.percentile_ms(0.5), stats.fetch_latency.percentile_ms(0.99));
+    std::println("  concurrency limit {:.1f} (peak {:.1f}), {} throttled responses",
+        stats.concurrency.load(), stats.peak_concurrency.load(), stats.throttled.load());
+    // relative to the -j cap, not to the adaptive limit above, which is usually lower.
+    // Time blocked on host limits is not busy time, it is reported on its own
+    auto busy = stats.busy_ns / 1e9 / wall;
+    std::println("  {:.1f} workers busy on average, {:.1f}% of the -j {} cap; {:.1f} waiting on host limits",
+        busy, busy / jobs * 100, (int)jobs, stats.limiter_wait_ns / 1e9 / wall);
+    std::println("  time in parse {:.2f} s, compress {:.2f} s, db writes {:.2f} s ({} batches)",
+        stats.parse_ns / 1e9, stats.compress_ns / 1e9, stats.db_write_ns / 1e9, stats.db_batches.load());
+#ifndef _WIN32
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    std::println("  peak rss {:.1f} MB", ru.ru_maxrss / 1024.);
+#endif
+    return 0;
+}
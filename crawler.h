@@ -0,0 +1,1448 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <primitives/executor.h>
+#include <primitives/hash.h>
+#include <primitives/http.h>
+#include <primitives/sw/cl.h>
+#include <primitives/templates2/sqlite.h>
+#include <primitives/templates2/html.h>
+
+#include <nlohmann/json.hpp>
+#include <sqlite3.h>
+
+#include "downloader.h"
+#include "limiter.h"
+#include "link_scanner.h"
+#include "lru_cache.h"
+#include "metrics.h"
+#include "page_codec.h"
+#include "url.h"
+#include "url_filter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <condition_variable>
+#include <format>
+#include <optional>
+#include <print>
+#include <random>
+#include <ranges>
+#include <syncstream>
+#include <thread>
+
+static cl::opt<bool> incremental("incremental", cl::desc("Revalidate cached pages with conditional requests and re-parse links only for changed pages"));
+static cl::opt<std::string> base_url("base-url", cl::desc("Override site base url, e.g. http://127.0.0.1:8080 for the local stand-in server"));
+static cl::opt<std::string> db_file("db", cl::desc("Crawl database"), cl::init("cppreference.db"s));
+static cl::opt<std::string> cache_db_file("cache-db", cl::desc("Legacy url request cache database, imported by --migrate-store"), cl::init("cache.db"s));
+static cl::opt<int> jobs("j", cl::desc("Number of crawler workers, the upper bound for concurrent downloads per host"), cl::init(32));
+static cl::opt<int> initial_concurrency("initial-concurrency", cl::desc("Concurrent downloads per host to start from"), cl::init(4));
+static cl::opt<bool> fixed_concurrency("fixed-concurrency", cl::desc("Always download with -j requests per host instead of adapting to latency and throttling"));
+static cl::opt<int> max_retries("max-retries", cl::desc("Retries of a failed page within one crawl, later runs pick it up again when its backoff expires"), cl::init(4));
+static cl::opt<std::string> rules_file("rules", cl::desc("Crawl scope rules file with [href] and [link] allow/deny sections, see url_filter.h"));
+static cl::opt<std::string> wikitext_mode("wikitext", cl::desc("Fetch page sources as wikitext into the wikitext table instead of crawling edit pages: "
+    "api (batched query, 50 titles per request) or raw (action=raw per page). Templates are listed with list=allpages"));
+static cl::opt<std::string> allpages("allpages", cl::desc("Seed the crawl with list=allpages of these comma separated namespaces (0 articles, 10 templates) "
+    "and fetch them in parallel instead of following links from the main page"));
+static cl::opt<int> cache_mb("cache-mb", cl::desc("Memory cache of decompressed page bodies in front of the store, 0 disables it. "
+    "Off while crawling unless given, a crawl reads every body once"), cl::init(256));
+static cl::opt<bool> resume("resume", cl::desc("Continue an interrupted crawl from its last checkpoint instead of walking from the main page"));
+static cl::opt<int> checkpoint_interval("checkpoint-interval", cl::desc("Seconds between frontier checkpoints"), cl::init(30));
+static cl::opt<int> progress_interval("progress-interval", cl::desc("Seconds between progress lines, 0 disables them"), cl::init(5));
+static cl::opt<std::string> metrics_out("metrics-out", cl::desc("Write crawl metrics at exit, json for *.json, prometheus text otherwise"));
+static cl::opt<bool> verbose("verbose", cl::desc("Print every downloaded url"));
+static cl::opt<double> max_rps("max-rps", cl::desc("Requests per second cap per host, 0 is unlimited"), cl::init(0.));
+static cl::opt<bool> compress_db_opt("compress-db", cl::desc("Train a compression dictionary on stored pages and recompress all blobs"));
+static cl::opt<bool> validate_links("validate-links", cl::desc("Cross-check the streaming link scanner against the html dom on every page"));
+static cl::opt<bool> migrate_store("migrate-store", cl::desc("Import the legacy page table and url request cache into the content-addressed store"));
+
+namespace db::parser {
+
+using namespace primitives::sqlite::db;
+
+struct schema {
+    struct tables_ {
+        // legacy, only read by --migrate-store
+        struct page {
+            type<int64_t, primary_key{}, autoincrement{}> page_id;
+            type<std::string, unique{}> name;
+            type<std::string> source;
+        } page_;
+        // content-addressed store: every body is kept once, names and urls point to it
+        struct blob {
+            type<int64_t, primary_key{}, autoincrement{}> blob_id;
+            type<std::string, unique{}> hash; // sha256 of the uncompressed body
+            type<std::string> data; // compressed with page_codec
+        } blob_;
+        struct page_name {
+            type<int64_t, primary_key{}, autoincrement{}> page_name_id;
+            type<std::string, unique{}> name;
+            type<std::string> hash;
+        } page_name_;
+        struct page_url {
+            type<int64_t, primary_key{}, autoincrement{}> page_url_id;
+            type<std::string, unique{}> url;
+            type<std::string> hash;
+        } page_url_;
+        struct page_revision {
+            type<int64_t, primary_key{}, autoincrement{}> page_revision_id;
+            type<std::string, unique{}> name;
+            type<int64_t> revision; // mediawiki wgCurRevisionId
+            type<int64_t> fetched_at; // unix time, sent back as If-Modified-Since
+            type<std::string> links; // '\n' separated, reused while the page is not modified
+        } page_revision_;
+        // pages that could not be fetched, retried with backoff; attempts = 0 marks a recovered page
+        struct fetch_failure {
+            type<int64_t, primary_key{}, autoincrement{}> fetch_failure_id;
+            type<std::string, unique{}> name;
+            type<int64_t> attempts; // over all runs
+            type<std::string> last_error;
+            type<int64_t> next_retry; // unix time
+        } fetch_failure_;
+        // frontier checkpoints for --resume, one row per visited page of the latest crawl run
+        struct crawl_run {
+            type<int64_t, primary_key{}, autoincrement{}> crawl_run_id;
+            type<int64_t, unique{}> started_at; // unix time, identifies the run
+            type<int64_t> finished_at; // 0 while running or after an interruption
+        } crawl_run_;
+        struct crawl_checkpoint {
+            type<int64_t, primary_key{}, autoincrement{}> crawl_checkpoint_id;
+            type<std::string, unique{}> name;
+            type<int64_t> run; // crawl_run::started_at, rows of older runs are stale
+            type<int64_t> done; // 0 = still in the frontier
+        } crawl_checkpoint_;
+        // page sources, filled by --wikitext instead of edit page html
+        struct wikitext {
+            type<int64_t, primary_key{}, autoincrement{}> wikitext_id;
+            type<std::string, unique{}> name; // mediawiki title
+            type<int64_t> revision;
+            type<std::string> text; // compressed with page_codec
+        } wikitext_;
+        struct dictionary {
+            type<int64_t, primary_key{}, autoincrement{}> dictionary_id;
+            type<int64_t> zstd_id;
+            type<std::string> data;
+        } dictionary_;
+    } tables;
+};
+
+} // namespace db::parser
+
+// legacy, only read by --migrate-store
+struct url_request_cache : primitives::sqlite::kv<std::string, std::string> {};
+static auto &cache() {
+    // init once first
+    static auto f = []() {
+        primitives::sqlite::cache <
+            url_request_cache
+        > c{ cache_db_file.getValue() };
+        c.enable_wal();
+        c.set_busy_timeout(5s);
+        return c;
+        };
+    static auto c = f();
+    thread_local auto tl = f();
+    return tl;
+}
+// stored bodies go through the codec
+static auto &codec() {
+    static auto c = []() {
+        page_codec c;
+        primitives::sqlite::sqlitemgr db{db_file.getValue()};
+        db.create_tables(::db::parser::schema{});
+        // in insertion order, the newest one is used for writing
+        for (auto &&d : db.select<::db::parser::schema::tables_::dictionary>()) {
+            c.add_dictionary(d.data);
+        }
+        return c;
+    }();
+    return c;
+}
+
+// decompressed bodies by hash, shared by all store connections
+static auto &body_cache() {
+    static sharded_lru_cache c{(size_t)std::max(0, (int)cache_mb) * 1024 * 1024};
+    return c;
+}
+
+struct page_store {
+    using tables = ::db::parser::schema::tables_;
+    using body = sharded_lru_cache::value_type; // null when not found
+
+    primitives::sqlite::sqlitemgr &db;
+
+    body find_hash(const std::string &hash) {
+        if (auto b = body_cache().find(hash)) {
+            return b;
+        }
+        auto sel = db.select<tables::blob, &tables::blob::hash>(hash);
+        if (auto i = sel.begin(); i != sel.end()) {
+            auto b = std::make_shared<const std::string>(codec().decompress((*i).data));
+            body_cache().insert(hash, b);
+            return b;
+        }
+        return {};
+    }
+    body find_name(const std::string &name) {
+        auto sel = db.select<tables::page_name, &tables::page_name::name>(name);
+        if (auto i = sel.begin(); i != sel.end()) {
+            return find_hash((*i).hash);
+        }
+        return {};
+    }
+    body find_url(const std::string &url) {
+        auto sel = db.select<tables::page_url, &tables::page_url::url>(url);
+        if (auto i = sel.begin(); i != sel.end()) {
+            return find_hash((*i).hash);
+        }
+        return {};
+    }
+
+    // callers wrap several puts into one transaction, the crawler writes through db_writer instead
+    std::string put_blob(const std::string &source) {
+        auto hash = sha256(source);
+        auto ins = db.prepared_insert<tables::blob, primitives::sqlite::db::or_ignore{}>();
+        ins.insert({ .hash = hash, .data = codec().compress(source) });
+        return hash;
+    }
+    void put_name(const std::string &name, const std::string &hash) {
+        auto ins = db.prepared_insert<tables::page_name, primitives::sqlite::db::or_replace{}>();
+        ins.insert({ .name = name, .hash = hash });
+    }
+    void put_url(const std::string &url, const std::string &hash) {
+        auto ins = db.prepared_insert<tables::page_url, primitives::sqlite::db::or_replace{}>();
+        ins.insert({ .url = url, .hash = hash });
+    }
+
+    // streams (key, value) rows of a keyed table in key order through one sqlite cursor.
+    // The literal head of the glob pattern becomes a range on the unique key index and sqlite applies the rest,
+    // value() reads the column only when asked, so skipped rows cost neither io nor decompression.
+    void scan(std::string_view table, std::string_view key, std::string_view value, const std::string &pattern, auto &&f) {
+        auto prefix = std::string{glob_prefix(pattern)};
+        // smallest string greater than all strings with this prefix
+        auto upper = prefix;
+        while (!upper.empty() && (unsigned char)upper.back() == 0xff) {
+            upper.pop_back();
+        }
+        if (!upper.empty()) {
+            ++upper.back();
+        }
+        auto sql = std::format("select {1}, {2} from {0} where {1} glob ?1", table, key, value);
+        if (!prefix.empty()) {
+            sql += std::format(" and {} >= ?2", key);
+        }
+        if (!upper.empty()) {
+            sql += std::format(" and {} < ?3", key);
+        }
+        sql += std::format(" order by {}", key);
+
+        sqlite3_stmt *p{};
+        if (sqlite3_prepare_v2(db.db, sql.c_str(), -1, &p, nullptr) != SQLITE_OK) {
+            throw std::runtime_error{std::format("cannot scan {}: {}", table, sqlite3_errmsg(db.db))};
+        }
+        std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt{p, sqlite3_finalize};
+        auto bind = [&](int i, const std::string &v) {
+            if (sqlite3_bind_text(p, i, v.data(), v.size(), SQLITE_STATIC) != SQLITE_OK) {
+                throw std::runtime_error{std::format("cannot scan {}: {}", table, sqlite3_errmsg(db.db))};
+            }
+        };
+        bind(1, pattern);
+        if (!prefix.empty()) {
+            bind(2, prefix);
+        }
+        if (!upper.empty()) {
+            bind(3, upper);
+        }
+        auto column = [&](int i) {
+            auto data = (const char *)sqlite3_column_blob(p, i);
+            return std::string_view{data ? data : "", (size_t)sqlite3_column_bytes(p, i)};
+        };
+        int r;
+        while ((r = sqlite3_step(p)) == SQLITE_ROW) {
+            f(column(0), [&] { return column(1); });
+        }
+        if (r != SQLITE_DONE) {
+            throw std::runtime_error{std::format("cannot scan {}: {}", table, sqlite3_errmsg(db.db))};
+        }
+    }
+};
+// thread local reader connection, init once first
+static auto store() {
+    static auto f = []() {
+        auto db = std::make_unique<primitives::sqlite::sqlitemgr>(db_file.getValue());
+        db->create_tables(::db::parser::schema{});
+        db->enable_wal();
+        db->set_busy_timeout(5s);
+        return db;
+    };
+    static auto c = f();
+    thread_local auto tl = f();
+    return page_store{*tl};
+}
+
+const path mirror_root_dir = "cppreference";
+
+auto url_base = "cppreference.com"s;
+//auto lang = "en"s;
+auto lang = "dev"s;
+auto protocol = "https"s;
+//auto normal_page = "/w"s;
+auto normal_page = ""s;
+
+
+auto make_base_url() {
+    if (!base_url.empty()) {
+        return base_url.getValue();
+    }
+    return std::format("{}://{}.{}", protocol, lang, url_base);
+}
+auto make_normal_page_url(auto &&page) {
+    if (page.starts_with("http")) {
+        return page;
+    }
+    return std::format("{}{}/{}", make_base_url(), normal_page,
+        //primitives::http::url_encode(page)
+        page
+    );
+}
+// site relative name of a page url, e.g. cpp/container/vector
+std::string_view make_page_name(std::string_view url) {
+    static const auto prefix = make_normal_page_url(""s);
+    if (url.starts_with(prefix)) {
+        url.remove_prefix(prefix.size());
+    }
+    return url;
+}
+void make_edit_page_name(std::string_view page, std::string &out) {
+    out = "index.php?title="sv;
+    out += page;
+    out += "&action=edit"sv;
+}
+
+std::set<std::string> mediawiki_pages;
+// compiled once, before workers start
+const auto &rules() {
+    static const auto r = rules_file.empty()
+        ? crawl_rules::parse(crawl_rules::default_rules)
+        : crawl_rules::parse(read_file(rules_file.getValue()));
+    return r;
+}
+
+// crawl measurements for progress reports, --metrics-out and crawl_bench
+struct crawl_stats {
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point started = clock::now();
+    std::atomic<int64_t> pages{};
+    std::atomic<int64_t> downloads{};
+    std::atomic<int64_t> download_errors{};
+    std::atomic<int64_t> bytes{}; // decoded
+    std::atomic<int64_t> wire_bytes{}; // as transferred, compressed
+    std::atomic<int64_t> connections{}; // newly opened, the rest of downloads reused one
+    std::atomic<int64_t> busy_ns{}; // summed over workers, without limiter_wait_ns
+    std::atomic<int64_t> limiter_wait_ns{}; // blocked on host rps and concurrency limits
+    std::atomic<int64_t> throttled{}; // 429 and 5xx answers
+    std::atomic<int64_t> cache_hits{}; // pages served from the store
+    std::atomic<int64_t> cache_misses{};
+    std::atomic<int64_t> parse_ns{}; // link extraction
+    std::atomic<int64_t> compress_ns{}; // hashing and compression before the writer queue
+    std::atomic<int64_t> db_write_ns{}; // writer transactions
+    std::atomic<int64_t> db_batches{};
+    std::atomic<int64_t> db_rows{};
+    std::atomic<double> concurrency{}; // current adaptive limit
+    std::atomic<double> peak_concurrency{};
+    // gauges
+    std::atomic<int64_t> in_flight{}; // scheduled pages, including waiting retries
+    std::atomic<int64_t> active_workers{};
+    std::atomic<int64_t> waiting_workers{}; // of the active ones, blocked on host limits
+    std::atomic<int64_t> writer_queue{};
+    latency_histogram fetch_latency;
+
+    void add_fetch(clock::duration d, const http_response &r, bool ok) {
+        ++downloads;
+        if (!ok) {
+            ++download_errors;
+        }
+        bytes += r.response.size();
+        wire_bytes += r.wire_bytes;
+        connections += r.new_connections;
+        fetch_latency.add(d);
+    }
+    static inline thread_local int64_t thread_limiter_wait_ns{}; // lets workers take the wait out of their busy time
+
+    static int64_t since(clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    }
+    double elapsed() const {
+        return std::chrono::duration<double>(clock::now() - started).count();
+    }
+
+    std::string progress_line() const {
+        auto t = elapsed();
+        return std::format("[{:.0f}s] {} pages ({:.1f}/s), in flight {}, active {}/{} ({} waiting on limits), limit {:.1f}, "
+            "store hit/miss {}/{}, memory hit/miss {}/{}, {:.1f} MB, fetch p50 {:.0f} ms p99 {:.0f} ms, "
+            "time parse {:.1f}s compress {:.1f}s db {:.1f}s, writer queue {}",
+            t, pages.load(), pages / std::max(t, 1e-9), in_flight.load(), active_workers.load(), (int)jobs, waiting_workers.load(), concurrency.load(),
+            cache_hits.load(), cache_misses.load(), body_cache().hits.load(), body_cache().misses.load(), wire_bytes / 1024. / 1024,
+            fetch_latency.percentile_ms(0.5), fetch_latency.percentile_ms(0.99),
+            parse_ns / 1e9, compress_ns / 1e9, db_write_ns / 1e9, writer_queue.load());
+    }
+    metrics_output metrics() const {
+        metrics_output m;
+        m.counter("crawl_pages_total", "Crawled pages", pages);
+        m.counter("crawl_store_hits_total", "Pages read from the store", cache_hits);
+        m.counter("crawl_store_misses_total", "Pages not in the store", cache_misses);
+        m.counter("crawl_body_cache_hits_total", "Store bodies served from memory", body_cache().hits);
+        m.counter("crawl_body_cache_misses_total", "Store bodies read from sqlite", body_cache().misses);
+        m.counter("crawl_downloads_total", "Http requests", downloads);
+        m.counter("crawl_download_errors_total", "Http requests without a 200 or 304 answer", download_errors);
+        m.counter("crawl_throttled_total", "429 and 5xx answers", throttled);
+        m.counter("crawl_connections_total", "Newly opened connections", connections);
+        m.counter("crawl_bytes_total", "Decoded body bytes", bytes);
+        m.counter("crawl_wire_bytes_total", "Body bytes as transferred", wire_bytes);
+        m.counter("crawl_worker_busy_seconds_total", "Time workers spent on pages, without waiting on host limits", busy_ns / 1e9);
+        m.counter("crawl_limiter_wait_seconds_total", "Time spent waiting on host rps and concurrency limits", limiter_wait_ns / 1e9);
+        m.counter("crawl_parse_seconds_total", "Time spent extracting links", parse_ns / 1e9);
+        m.counter("crawl_compress_seconds_total", "Time spent hashing and compressing bodies", compress_ns / 1e9);
+        m.counter("crawl_db_write_seconds_total", "Time spent in writer transactions", db_write_ns / 1e9);
+        m.counter("crawl_db_batches_total", "Writer transactions", db_batches);
+        m.counter("crawl_db_rows_total", "Queued writer items", db_rows);
+        m.gauge("crawl_elapsed_seconds", "Crawl wall time", elapsed());
+        m.gauge("crawl_concurrency_limit", "Adaptive download concurrency", concurrency);
+        m.gauge("crawl_peak_concurrency_limit", "Highest adaptive download concurrency", peak_concurrency);
+        m.gauge("crawl_in_flight", "Scheduled pages", in_flight);
+        m.gauge("crawl_active_workers", "Workers busy with a page", active_workers);
+        m.gauge("crawl_waiting_workers", "Workers waiting on host limits", waiting_workers);
+        m.gauge("crawl_writer_queue", "Pages waiting for the writer", writer_queue);
+        m.add("crawl_fetch_latency_seconds", "Http request latency", fetch_latency);
+        return m;
+    }
+    // json for *.json, prometheus text otherwise
+    void write_metrics(const path &fn) const {
+        auto m = metrics();
+        write_file(fn, fn.extension() == ".json" ? m.json() : m.prometheus());
+    }
+};
+inline crawl_stats stats;
+
+struct host_limits {
+    aimd_limiter concurrency{fixed_concurrency ? (double)jobs : (double)initial_concurrency, (double)jobs, !fixed_concurrency};
+    token_bucket rps{max_rps};
+};
+auto &limits_for(const std::string &url) {
+    static std::mutex m;
+    static std::map<std::string, std::unique_ptr<host_limits>, std::less<>> hosts;
+    auto host = uri_ref{url}.authority;
+    std::unique_lock lk{m};
+    auto i = hosts.find(host);
+    if (i == hosts.end()) {
+        i = hosts.emplace(host, std::make_unique<host_limits>()).first;
+    }
+    return *i->second;
+}
+
+auto make_request(const std::string &url) {
+    http_request req;
+    req.url = url;
+    req.timeout = 90;
+    req.proxy = httpSettings.proxy.host;
+    req.proxy_user = httpSettings.proxy.user;
+    req.ignore_ssl_checks = httpSettings.ignore_ssl_checks;
+    req.verbose = httpSettings.verbose;
+    return req;
+}
+struct fetch_error : std::runtime_error {
+    int http_code;
+
+    fetch_error(const std::string &url, int http_code)
+        : std::runtime_error{std::format("url = {}, http code = {}", url, http_code)}, http_code{http_code} {
+    }
+    // 404 and friends will not get better by asking again soon
+    bool transient() const {
+        return http_code == 429 || http_code >= 500;
+    }
+};
+// exponential backoff with equal jitter: half of the delay is fixed, the other half random
+std::chrono::milliseconds retry_delay(int64_t attempt, std::chrono::milliseconds base, std::chrono::milliseconds cap) {
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    auto d = std::min(cap, base * (1ll << std::min<int64_t>(attempt - 1, 30)));
+    return d / 2 + std::chrono::milliseconds{std::uniform_int_distribution<int64_t>{0, d.count() / 2}(rng)};
+}
+
+// every request goes through the limits of its host, throttled and failed requests only feed the limiter back;
+// they are retried by the crawler with backoff (parser::fail()), not here
+http_response fetch(const http_request &req) {
+    auto &l = limits_for(req.url);
+    auto wait_start = crawl_stats::clock::now();
+    ++stats.waiting_workers;
+    l.rps.acquire();
+    l.concurrency.acquire();
+    --stats.waiting_workers;
+    auto waited = crawl_stats::since(wait_start);
+    stats.limiter_wait_ns += waited;
+    crawl_stats::thread_limiter_wait_ns += waited;
+    auto start = std::chrono::steady_clock::now();
+    http_response resp;
+    try {
+        resp = downloader::local().get(req);
+    } catch (std::exception &) {
+        // timeouts, resets and dns failures: a failed download, and the host may be overloaded
+        auto d = std::chrono::steady_clock::now() - start;
+        l.concurrency.release(d, fetch_outcome::overloaded);
+        stats.add_fetch(d, resp, false);
+        throw;
+    }
+    auto overloaded = resp.http_code == 429 || resp.http_code >= 500;
+    auto d = std::chrono::steady_clock::now() - start;
+    l.concurrency.release(d, overloaded ? fetch_outcome::overloaded : fetch_outcome::ok);
+    stats.add_fetch(d, resp, resp.http_code == 200 || resp.http_code == 304);
+    auto c = l.concurrency.current_limit();
+    stats.concurrency = c;
+    if (c > stats.peak_concurrency) {
+        stats.peak_concurrency = c;
+    }
+    if (overloaded) {
+        ++stats.throttled;
+    }
+    return resp;
+}
+
+// does not store the body, parse_page puts it under both name and url
+std::string download_url(const std::string &url) {
+    if (auto s = store().find_url(url)) {
+        ++stats.cache_hits;
+        return *s;
+    }
+    ++stats.cache_misses;
+    if (verbose) {
+        std::osyncstream{ std::cout } << std::format("downloading {}\n", url);
+    }
+
+    auto resp = fetch(make_request(url));
+    if (resp.http_code != 200) {
+        throw fetch_error{url, (int)resp.http_code};
+    }
+    return resp.response;
+}
+// conditional GET, returns nothing when the server answered 304 Not Modified
+std::optional<std::string> revalidate_url(const std::string &url, int64_t fetched_at) {
+    if (verbose) {
+        std::osyncstream{ std::cout } << std::format("revalidating {}\n", url);
+    }
+
+    auto req = make_request(url);
+    if (fetched_at) {
+        req.headers.push_back(std::format("If-Modified-Since: {:%a, %d %b %Y %H:%M:%S} GMT",
+            std::chrono::sys_seconds{std::chrono::seconds{fetched_at}}));
+    }
+    auto resp = fetch(req);
+    if (resp.http_code == 304) {
+        return {};
+    }
+    if (resp.http_code != 200) {
+        throw fetch_error{url, (int)resp.http_code};
+    }
+    return resp.response;
+}
+auto unix_time() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+int64_t parse_revision(std::string_view source) {
+    constexpr auto key = "\"wgCurRevisionId\":"sv;
+    int64_t r{};
+    if (auto p = source.find(key); p != -1) {
+        std::from_chars(source.data() + p + key.size(), source.data() + source.size(), r);
+    }
+    return r;
+}
+
+// --wikitext: page sources straight from mediawiki instead of the textarea of edit pages
+struct wikitext_page {
+    std::string title;
+    int64_t revision{};
+    std::string text;
+};
+// one api request per up to 50 titles, follows continuation when the content limit splits the answer.
+// Missing titles are not returned.
+std::vector<wikitext_page> fetch_wikitext_batch(const std::vector<std::string> &titles) {
+    std::string joined;
+    for (auto &&t : titles) {
+        if (!joined.empty()) {
+            joined += "%7C";
+        }
+        joined += primitives::http::url_encode(t);
+    }
+    std::vector<wikitext_page> out;
+    std::map<std::string, std::string> normalized; // returned title -> requested one
+    std::string cont;
+    do {
+        auto url = make_normal_page_url(std::format(
+            "api.php?action=query&format=json&formatversion=2&prop=revisions&rvprop=ids%7Ccontent&rvslots=main&titles={}{}", joined, cont));
+        auto resp = fetch(make_request(url));
+        if (resp.http_code != 200) {
+            throw fetch_error{url, (int)resp.http_code};
+        }
+        auto j = nlohmann::json::parse(resp.response);
+        if (j.contains("error")) {
+            throw std::runtime_error{std::format("url = {}, api error: {}", url, j["error"].dump())};
+        }
+        auto &q = j["query"];
+        if (q.contains("normalized")) {
+            for (auto &&n : q["normalized"]) {
+                normalized[n["to"].get<std::string>()] = n["from"].get<std::string>();
+            }
+        }
+        for (auto &&p : q["pages"]) {
+            if (!p.contains("revisions")) {
+                continue; // missing, invalid or in the next continuation
+            }
+            auto &r = p["revisions"][0];
+            auto title = p["title"].get<std::string>();
+            if (auto i = normalized.find(title); i != normalized.end()) {
+                title = i->second;
+            }
+            out.push_back({ title, r["revid"].get<int64_t>(), r["slots"]["main"]["content"].get<std::string>() });
+        }
+        cont.clear();
+        if (j.contains("continue")) {
+            for (auto &&[k, v] : j["continue"].items()) {
+                cont += std::format("&{}={}", k, primitives::http::url_encode(v.get<std::string>()));
+            }
+        }
+    } while (!cont.empty());
+    return out;
+}
+// list=allpages of one namespace, f(std::vector<std::string> titles) per answer
+void list_allpages(int ns, auto &&f) {
+    std::string cont;
+    do {
+        auto url = make_normal_page_url(std::format(
+            "api.php?action=query&format=json&formatversion=2&list=allpages&apnamespace={}&aplimit=500{}", ns, cont));
+        auto resp = fetch(make_request(url));
+        if (resp.http_code != 200) {
+            throw fetch_error{url, (int)resp.http_code};
+        }
+        auto j = nlohmann::json::parse(resp.response);
+        if (j.contains("error")) {
+            throw std::runtime_error{std::format("url = {}, api error: {}", url, j["error"].dump())};
+        }
+        std::vector<std::string> titles;
+        for (auto &&p : j["query"]["allpages"]) {
+            titles.push_back(p["title"].get<std::string>());
+        }
+        f(std::move(titles));
+        cont.clear();
+        if (j.contains("continue")) {
+            for (auto &&[k, v] : j["continue"].items()) {
+                cont += std::format("&{}={}", k, primitives::http::url_encode(v.get<std::string>()));
+            }
+        }
+    } while (!cont.empty());
+}
+std::string fetch_wikitext_raw(const std::string &title) {
+    auto url = make_normal_page_url(std::format("index.php?title={}&action=raw", primitives::http::url_encode(title)));
+    auto resp = fetch(make_request(url));
+    if (resp.http_code != 200) {
+        throw fetch_error{url, (int)resp.http_code};
+    }
+    return resp.response;
+}
+
+struct page {
+    std::string url;
+    std::string source;
+    std::vector<url_id> links; // sorted, unique
+
+    page() = default;
+    page(const std::string &url) : url{url} {
+        source = download_url(url);
+        parse_links();
+    }
+    bool is_c_page() const {
+        return url.contains("/w/c/"sv) || url.ends_with("/w/c"sv);
+    }
+    bool is_cpp_page() const {
+        return url.contains("/w/cpp/"sv) || url.ends_with("/w/cpp"sv);
+    }
+    void parse_links() {
+        auto start = crawl_stats::clock::now();
+        link_scanner{source}.for_each([&](std::string_view href) {
+            add_link(href);
+        });
+        std::ranges::sort(links);
+        links.erase(std::ranges::unique(links).begin(), links.end());
+        stats.parse_ns += crawl_stats::since(start);
+        if (validate_links) {
+            validate_scanned_links();
+        }
+    }
+    // cross-check the scanner against the dom
+    void validate_scanned_links() const {
+        std::multiset<std::string> scanned, dom;
+        link_scanner{source}.for_each([&](std::string_view href) {
+            scanned.emplace(href);
+        });
+        primitives::html::root r{source};
+        for (auto &&n : r | std::views::filter([](auto &&n){return n.is("a"sv) && n.has("href"sv);})) {
+            dom.emplace(*n.attribute("href"));
+        }
+        if (scanned == dom) {
+            return;
+        }
+        std::vector<std::string> only_scanned, only_dom;
+        std::ranges::set_difference(scanned, dom, std::back_inserter(only_scanned));
+        std::ranges::set_difference(dom, scanned, std::back_inserter(only_dom));
+        std::osyncstream s{ std::cerr };
+        s << std::format("link scanner mismatch on {}\n", url);
+        for (auto &&l : only_scanned) {
+            s << std::format("  scanner only: {}\n", l);
+        }
+        for (auto &&l : only_dom) {
+            s << std::format("  dom only: {}\n", l);
+        }
+    }
+    void add_link(std::string_view l) {
+        if (!rules().href.allowed(l)) {
+            return;
+        }
+        l = l.substr(0, l.find('#')); // take everything before '#'
+        l = l.substr(0, l.find('?')); // take everything before '?'
+        if (l.empty() || l == "/"sv) {
+            return;
+        }
+        thread_local std::string abs, edit;
+        resolve_uri(url, l, abs);
+        auto name = make_page_name(abs);
+        if (name.contains("://"sv)) {
+            return; // other site
+        }
+        links.push_back(urls.intern(name));
+        if (l.starts_with('/') && wikitext_mode.empty()) {
+            // we must parse everything because template pages are not fully connected
+            // (wikitext mode fetches the sources of crawled pages through the api instead
+            // and seeds the template namespace from list=allpages, see seed_namespaces())
+            make_edit_page_name(name, edit);
+            links.push_back(urls.intern(edit));
+        }
+    }
+};
+
+// group commit: workers hand finished pages over a queue and never touch the db,
+// one thread commits them in batches of batch_size or every flush_interval.
+// The queue is bounded, so a slow disk holds workers back instead of piling up compressed bodies.
+struct db_writer {
+    using tables = ::db::parser::schema::tables_;
+
+    static inline constexpr size_t batch_size = 256;
+    static inline constexpr size_t max_queue = 4 * batch_size;
+    static inline constexpr auto flush_interval = 500ms;
+
+    struct item {
+        std::string name;
+        // empty when only the revision row changes
+        std::string url;
+        std::string hash;
+        std::string data; // compressed by the worker
+        int64_t revision{};
+        int64_t fetched_at{};
+        std::string links;
+    };
+    struct failure_item {
+        std::string name;
+        int64_t attempts{};
+        std::string last_error;
+        int64_t next_retry{};
+    };
+    struct checkpoint_item {
+        std::string name;
+        int64_t done{};
+    };
+    struct wikitext_item {
+        std::string name;
+        int64_t revision{};
+        std::string text; // compressed by the caller
+    };
+
+    primitives::sqlite::sqlitemgr db{db_file.getValue()};
+    std::mutex m;
+    std::condition_variable cv, space;
+    std::vector<item> queue;
+    std::vector<failure_item> failures;
+    std::vector<checkpoint_item> checkpoints;
+    std::vector<wikitext_item> wikitexts;
+    int64_t run_started_at{};
+    int64_t run_finished_at{};
+    bool stop{};
+    std::thread t;
+
+    db_writer() {
+        db.create_tables(::db::parser::schema{});
+        db.enable_wal();
+        db.set_busy_timeout(5s);
+        t = std::thread{[this]{run();}};
+    }
+    ~db_writer() {
+        {
+            std::unique_lock lk{m};
+            stop = true;
+        }
+        cv.notify_all();
+        t.join();
+    }
+
+    void push(const std::string &name, const page &p, bool with_body) {
+        item i{ .name = name, .revision = parse_revision(p.source), .fetched_at = unix_time() };
+        if (with_body) {
+            auto start = crawl_stats::clock::now();
+            i.url = p.url;
+            i.hash = sha256(p.source);
+            i.data = codec().compress(p.source);
+            stats.compress_ns += crawl_stats::since(start);
+        }
+        for (auto &&l : p.links) {
+            i.links += urls[l];
+            i.links += '\n';
+        }
+        std::unique_lock lk{m};
+        space.wait(lk, [&]{return queue.size() < max_queue;});
+        queue.push_back(std::move(i));
+        ++stats.db_rows;
+        stats.writer_queue = queue.size();
+        if (queue.size() >= batch_size) {
+            cv.notify_all();
+        }
+    }
+    void push_wikitext(wikitext_item w) {
+        std::unique_lock lk{m};
+        space.wait(lk, [&]{return wikitexts.size() < max_queue;});
+        wikitexts.push_back(std::move(w));
+        ++stats.db_rows;
+    }
+    void push_failure(failure_item f) {
+        std::unique_lock lk{m};
+        failures.push_back(std::move(f));
+    }
+    // committed after the pages pushed before, so a checkpoint never refers to a page that is not stored yet
+    void push_checkpoint(std::vector<checkpoint_item> items, int64_t started_at, int64_t finished_at = 0) {
+        std::unique_lock lk{m};
+        checkpoints.append_range(std::move(items));
+        run_started_at = started_at;
+        run_finished_at = finished_at;
+        cv.notify_all();
+    }
+    void run() {
+        auto blob_ins = db.prepared_insert<tables::blob, primitives::sqlite::db::or_ignore{}>();
+        auto name_ins = db.prepared_insert<tables::page_name, primitives::sqlite::db::or_replace{}>();
+        auto url_ins = db.prepared_insert<tables::page_url, primitives::sqlite::db::or_replace{}>();
+        auto rev_ins = db.prepared_insert<tables::page_revision, primitives::sqlite::db::or_replace{}>();
+        auto failure_ins = db.prepared_insert<tables::fetch_failure, primitives::sqlite::db::or_replace{}>();
+        auto run_ins = db.prepared_insert<tables::crawl_run, primitives::sqlite::db::or_replace{}>();
+        auto checkpoint_ins = db.prepared_insert<tables::crawl_checkpoint, primitives::sqlite::db::or_replace{}>();
+        auto wikitext_ins = db.prepared_insert<tables::wikitext, primitives::sqlite::db::or_replace{}>();
+        while (1) {
+            std::vector<item> batch;
+            std::vector<failure_item> failure_batch;
+            std::vector<checkpoint_item> checkpoint_batch;
+            std::vector<wikitext_item> wikitext_batch;
+            int64_t started_at, finished_at;
+            bool last;
+            {
+                std::unique_lock lk{m};
+                cv.wait_for(lk, flush_interval, [&]{return stop || queue.size() >= batch_size;});
+                batch.swap(queue);
+                failure_batch.swap(failures);
+                checkpoint_batch.swap(checkpoints);
+                wikitext_batch.swap(wikitexts);
+                started_at = std::exchange(run_started_at, 0);
+                finished_at = run_finished_at;
+                last = stop;
+            }
+            stats.writer_queue = 0;
+            space.notify_all();
+            if (!batch.empty() || !failure_batch.empty() || !wikitext_batch.empty() || started_at) {
+                auto start = crawl_stats::clock::now();
+                {
+                    auto tr = db.scoped_transaction();
+                    for (auto &&i : batch) {
+                        if (!i.hash.empty()) {
+                            blob_ins.insert({ .hash = i.hash, .data = i.data });
+                            name_ins.insert({ .name = i.name, .hash = i.hash });
+                            url_ins.insert({ .url = i.url, .hash = i.hash });
+                        }
+                        rev_ins.insert({ .name = i.name, .revision = i.revision, .fetched_at = i.fetched_at, .links = i.links });
+                    }
+                    for (auto &&w : wikitext_batch) {
+                        wikitext_ins.insert({ .name = w.name, .revision = w.revision, .text = w.text });
+                    }
+                    for (auto &&f : failure_batch) {
+                        failure_ins.insert({ .name = f.name, .attempts = f.attempts, .last_error = f.last_error, .next_retry = f.next_retry });
+                    }
+                    if (started_at) {
+                        for (auto &&c : checkpoint_batch) {
+                            checkpoint_ins.insert({ .name = c.name, .run = started_at, .done = c.done });
+                        }
+                        run_ins.insert({ .started_at = started_at, .finished_at = finished_at });
+                    }
+                }
+                stats.db_write_ns += crawl_stats::since(start);
+                ++stats.db_batches;
+            }
+            if (last) {
+                break;
+            }
+        }
+    }
+};
+
+inline std::atomic<bool> interrupted;
+
+struct parser {
+    using clock = std::chrono::steady_clock;
+
+    enum class visit : uint8_t {
+        none,
+        skipped, // forbidden or still backing off, derived again on resume
+        queued,
+        done,
+    };
+    struct failure {
+        int64_t attempts{}; // over all runs
+        int64_t next_retry{};
+        int run_attempts{};
+        std::string error;
+    };
+
+    //primitives::sqlite::sqlitemgr db{path{ mirror_root_dir } += "_03.2026.db"};
+    std::vector<visit> processed_pages; // visited set by url id: everything ever seen, including bad and forbidden pages
+    std::vector<url_id> dirty; // visit changes since the last checkpoint
+    std::vector<int64_t> revisions; // by url id, -1 when not crawled in this run; for --wikitext
+    int64_t run_started_at = unix_time();
+    std::atomic<int64_t> changed_pages{}, unchanged_pages{};
+    std::unordered_map<url_id, failure> failures; // from the db and this run
+    std::multimap<clock::time_point, url_id> retries; // due time -> page, still counted as in flight
+    db_writer writer;
+
+    // continuous frontier: every finished page pushes its new links straight into the executor,
+    // so there is no barrier between bfs levels and workers never wait for the slowest page of a level.
+    // Returns false when interrupted, the frontier is checkpointed for --resume then.
+    bool start() {
+        if (!wikitext_mode.empty() && wikitext_mode != "api" && wikitext_mode != "raw") {
+            throw std::runtime_error{std::format("unknown --wikitext mode: {}", wikitext_mode.getValue())};
+        }
+        Executor e{(size_t)jobs};
+        std::mutex m;
+        std::condition_variable cv;
+        size_t in_flight{};
+        load_failures();
+        auto mark = [&](url_id id, visit v) {
+            if (processed_pages.size() <= id) {
+                processed_pages.resize(id + 1);
+            }
+            processed_pages[id] = v;
+            if (v == visit::queued || v == visit::done) {
+                dirty.push_back(id);
+            }
+        };
+        // must be called under m
+        auto enqueue = [&](this auto &&enqueue, url_id id, bool retry = false) -> void {
+            if (!retry) {
+                if (id < processed_pages.size() && processed_pages[id] != visit::none) {
+                    return;
+                }
+                // checked once per unique link
+                auto &t = urls[id];
+                if (t.starts_with("MediaWiki:"sv)) {
+                    mediawiki_pages.insert(t);
+                }
+                if (!rules().link.allowed(t)) {
+                    mark(id, visit::skipped);
+                    return;
+                }
+                // failed in an earlier run and still backing off
+                if (auto i = failures.find(id); i != failures.end() && i->second.next_retry > unix_time()) {
+                    mark(id, visit::skipped);
+                    return;
+                }
+                mark(id, visit::queued);
+                if (interrupted) {
+                    return; // stays in the checkpointed frontier
+                }
+                ++in_flight;
+            }
+            e.push([&, id]() {
+                if (interrupted) {
+                    std::unique_lock lk{m};
+                    if (--in_flight == 0) {
+                        cv.notify_all();
+                    }
+                    return;
+                }
+                auto start = clock::now();
+                auto waited = crawl_stats::thread_limiter_wait_ns;
+                ++stats.active_workers;
+                page pp;
+                std::optional<std::string> error;
+                bool transient = true;
+                try {
+                    pp = parse_page(urls[id]);
+                } catch (fetch_error &ex) {
+                    error = ex.what();
+                    transient = ex.transient();
+                } catch (std::exception &ex) {
+                    error = ex.what();
+                }
+                auto revision = parse_revision(pp.source);
+                // the body is in the writer queue or the store by now
+                std::string{}.swap(pp.source);
+                --stats.active_workers;
+                stats.busy_ns += crawl_stats::since(start) - (crawl_stats::thread_limiter_wait_ns - waited);
+                std::unique_lock lk{m};
+                if (error) {
+                    if (fail(id, *error, transient)) {
+                        cv.notify_all(); // new retry deadline
+                        return;
+                    }
+                } else {
+                    recover(id);
+                    // the listing already has every page
+                    if (allpages.empty()) {
+                        for (auto &&l : pp.links) {
+                            enqueue(l);
+                        }
+                    }
+                    if (revisions.size() <= id) {
+                        revisions.resize(id + 1, -1);
+                    }
+                    revisions[id] = revision;
+                    ++stats.pages;
+                }
+                // given up pages are done as well, the failure table keeps them
+                mark(id, visit::done);
+                if (--in_flight == 0) {
+                    cv.notify_all();
+                }
+            });
+        };
+        rules();
+        auto prev_handler = std::signal(SIGINT, [](int) {
+            interrupted = true;
+            std::signal(SIGINT, SIG_DFL); // second ^C kills
+        });
+        std::unique_lock lk{m};
+        if (resume) {
+            load_checkpoint(enqueue);
+        }
+        if (allpages.empty()) {
+            enqueue(urls.intern("Main_Page"sv));
+        }
+        if (auto namespaces = seed_namespaces(); !namespaces.empty()) {
+            // workers start on the first answer while the listing goes on
+            lk.unlock();
+            seed_allpages(namespaces, [&](const std::vector<std::string> &names) {
+                std::unique_lock lk{m};
+                for (auto &&n : names) {
+                    enqueue(urls.intern(n));
+                }
+            });
+            lk.lock();
+        }
+        // due retries from earlier runs, they may be unreachable from the main page now
+        for (auto &&[id, f] : failures) {
+            enqueue(id);
+        }
+        auto next_checkpoint = clock::now() + std::chrono::seconds{checkpoint_interval};
+        auto next_progress = clock::now() + std::chrono::seconds{progress_interval};
+        while (in_flight) {
+            stats.in_flight = in_flight;
+            // wake up regularly to notice ^C
+            auto deadline = std::min(next_checkpoint, clock::now() + 250ms);
+            if (!retries.empty()) {
+                deadline = std::min(deadline, retries.begin()->first);
+            }
+            cv.wait_until(lk, deadline);
+            auto now = clock::now();
+            if (interrupted && !retries.empty()) {
+                in_flight -= retries.size(); // stay queued in the checkpoint
+                retries.clear();
+            }
+            while (!retries.empty() && retries.begin()->first <= now) {
+                enqueue(retries.begin()->second, true);
+                retries.erase(retries.begin());
+            }
+            if (now >= next_checkpoint) {
+                checkpoint();
+                next_checkpoint = now + std::chrono::seconds{checkpoint_interval};
+            }
+            if (progress_interval > 0 && now >= next_progress) {
+                std::println("{}", stats.progress_line());
+                next_progress = now + std::chrono::seconds{progress_interval};
+            }
+        }
+        stats.in_flight = 0;
+        std::signal(SIGINT, prev_handler);
+        checkpoint(!interrupted);
+        if (incremental) {
+            std::println("revalidated {} pages: {} changed, {} not modified", changed_pages + unchanged_pages, changed_pages, unchanged_pages);
+        }
+        report_failures();
+        if (interrupted) {
+            std::println("interrupted, the frontier is saved, continue with --resume");
+            return false;
+        }
+        if (!wikitext_mode.empty()) {
+            fetch_wikitext(e);
+        }
+        return true;
+    }
+    // --allpages, plus the template namespace in wikitext mode: edit pages are not queued then,
+    // and templates are not all reachable by links from articles
+    static std::vector<std::string> seed_namespaces() {
+        auto namespaces = split_string(allpages, ",");
+        if (!wikitext_mode.empty() && !std::ranges::contains(namespaces, "10"s)) {
+            namespaces.push_back("10");
+        }
+        return namespaces;
+    }
+    void seed_allpages(const std::vector<std::string> &namespaces, auto &&enqueue_names) {
+        size_t n{};
+        std::string edit;
+        for (auto &&ns : namespaces) {
+            try {
+                list_allpages(std::stoi(ns), [&](std::vector<std::string> titles) {
+                    std::vector<std::string> names;
+                    for (auto &&t : titles) {
+                        names.push_back(mediawiki_title_to_name(t));
+                        // template sources come from edit pages unless --wikitext fetches them
+                        if (wikitext_mode.empty()) {
+                            make_edit_page_name(names.back(), edit);
+                            names.push_back(edit);
+                        }
+                    }
+                    n += titles.size();
+                    enqueue_names(names);
+                });
+            } catch (std::exception &e) {
+                std::cerr << std::format("allpages listing of namespace {} stopped: {}\n", ns, e.what());
+            }
+        }
+        std::println("allpages: {} titles listed in namespaces {}", n, namespaces | std::views::join_with(',') | std::ranges::to<std::string>());
+    }
+    // sources of the pages crawled in this run, the ones stored at their current revision are skipped
+    void fetch_wikitext(Executor &e) {
+        using tables = ::db::parser::schema::tables_;
+
+        std::map<std::string, int64_t> stored;
+        for (auto &&w : store().db.select<tables::wikitext>()) {
+            stored[w.name] = w.revision;
+        }
+        std::vector<std::pair<std::string, int64_t>> todo; // title, crawled revision
+        size_t up_to_date{};
+        for (url_id id = 0; id < revisions.size(); ++id) {
+            if (revisions[id] < 0 || urls[id].starts_with("index.php"sv)) {
+                continue;
+            }
+            auto title = percent_decode(urls[id]);
+            if (auto i = stored.find(title); i != stored.end() && revisions[id] && i->second == revisions[id]) {
+                ++up_to_date;
+                continue;
+            }
+            todo.emplace_back(std::move(title), revisions[id]);
+        }
+
+        auto raw = wikitext_mode == "raw";
+        std::mutex m;
+        std::condition_variable cv;
+        size_t left{};
+        std::atomic<int64_t> fetched{}, missing{}, errors{};
+        auto store_text = [&](const std::string &title, int64_t revision, const std::string &text) {
+            writer.push_wikitext({ .name = title, .revision = revision, .text = codec().compress(text) });
+            ++fetched;
+        };
+        for (auto &&chunk : todo | std::views::chunk(raw ? 1 : 50)) {
+            std::vector<std::pair<std::string, int64_t>> batch(chunk.begin(), chunk.end());
+            {
+                std::unique_lock lk{m};
+                ++left;
+            }
+            e.push([&, batch = std::move(batch)]() {
+                try {
+                    if (raw) {
+                        auto &[title, revision] = batch[0];
+                        store_text(title, revision, fetch_wikitext_raw(title));
+                    } else {
+                        std::vector<std::string> titles;
+                        for (auto &&[title, _] : batch) {
+                            titles.push_back(title);
+                        }
+                        auto pages = fetch_wikitext_batch(titles);
+                        for (auto &&p : pages) {
+                            store_text(p.title, p.revision, p.text);
+                        }
+                        missing += titles.size() - std::min(titles.size(), pages.size());
+                    }
+                } catch (std::exception &ex) {
+                    ++errors;
+                    std::cerr << ex.what() << "\n";
+                }
+                std::unique_lock lk{m};
+                if (--left == 0) {
+                    cv.notify_all();
+                }
+            });
+        }
+        std::unique_lock lk{m};
+        cv.wait(lk, [&]{return left == 0;});
+        std::println("wikitext: {} fetched, {} up to date, {} missing, {} failed requests", fetched.load(), up_to_date, missing.load(), errors.load());
+    }
+    // must be called under m
+    void checkpoint(bool finished = false) {
+        std::vector<db_writer::checkpoint_item> items;
+        items.reserve(dirty.size());
+        for (auto id : dirty) {
+            items.push_back({ .name = urls[id], .done = processed_pages[id] == visit::done });
+        }
+        dirty.clear();
+        writer.push_checkpoint(std::move(items), run_started_at, finished ? unix_time() : 0);
+    }
+    // continues the latest run: done pages are not walked again, the frontier is scheduled
+    void load_checkpoint(auto &&enqueue) {
+        using tables = ::db::parser::schema::tables_;
+
+        int64_t run{}, finished_at{};
+        for (auto &&r : store().db.select<tables::crawl_run>()) {
+            if (r.started_at > run) {
+                run = r.started_at;
+                finished_at = r.finished_at;
+            }
+        }
+        if (!run || finished_at) {
+            std::println("no interrupted crawl to resume, starting from the main page");
+            return;
+        }
+        run_started_at = run;
+        std::vector<url_id> frontier;
+        std::unordered_map<std::string, url_id> done;
+        for (auto &&c : store().db.select<tables::crawl_checkpoint>()) {
+            if (c.run != run) {
+                continue;
+            }
+            auto id = urls.intern(c.name);
+            if (c.done) {
+                if (processed_pages.size() <= id) {
+                    processed_pages.resize(id + 1);
+                }
+                processed_pages[id] = visit::done;
+                if (revisions.size() <= id) {
+                    revisions.resize(id + 1, -1);
+                }
+                revisions[id] = 0; // unknown until the row below, fetch_wikitext() then always asks
+                done.emplace(c.name, id);
+            } else {
+                frontier.push_back(id);
+            }
+        }
+        // revisions of the pages crawled before the interruption, fetch_wikitext() covers them as well
+        for (auto &&r : store().db.select<tables::page_revision>()) {
+            if (auto i = done.find(r.name); i != done.end()) {
+                revisions[i->second] = r.revision;
+            }
+        }
+        std::println("resuming crawl: {} pages done, {} in the frontier", std::ranges::count(processed_pages, visit::done), frontier.size());
+        for (auto id : frontier) {
+            enqueue(id);
+        }
+    }
+    void load_failures() {
+        using tables = ::db::parser::schema::tables_;
+        for (auto &&f : store().db.select<tables::fetch_failure>()) {
+            if (f.attempts > 0) {
+                failures[urls.intern(f.name)] = { .attempts = f.attempts, .next_retry = f.next_retry, .error = f.last_error };
+            }
+        }
+    }
+    // must be called under m, returns true when the page is scheduled for another attempt in this run
+    bool fail(url_id id, const std::string &error, bool transient) {
+        using namespace std::chrono;
+
+        auto &f = failures[id];
+        ++f.attempts;
+        ++f.run_attempts;
+        f.error = error;
+        f.next_retry = unix_time() + duration_cast<seconds>(retry_delay(f.attempts, 1min, 24h)).count();
+        writer.push_failure({ .name = urls[id], .attempts = f.attempts, .last_error = f.error, .next_retry = f.next_retry });
+        std::cerr << std::format("{} (attempt {})\n", error, f.attempts);
+        if (!transient || f.run_attempts > max_retries) {
+            return false;
+        }
+        retries.emplace(clock::now() + retry_delay(f.run_attempts, 1s, 1min), id);
+        return true;
+    }
+    // must be called under m
+    void recover(url_id id) {
+        if (auto i = failures.find(id); i != failures.end()) {
+            writer.push_failure({ .name = urls[id] });
+            failures.erase(i);
+        }
+    }
+    void report_failures() {
+        if (failures.empty()) {
+            return;
+        }
+        std::vector<std::pair<std::string_view, const failure *>> missing;
+        for (auto &&[id, f] : failures) {
+            missing.emplace_back(urls[id], &f);
+        }
+        std::ranges::sort(missing);
+        std::println("{} pages are still missing:", missing.size());
+        for (auto &&[name, f] : missing) {
+            std::println("  {}: {} attempts, next retry in {} s, {}", name, f->attempts, std::max<int64_t>(0, f->next_retry - unix_time()), f->error);
+        }
+    }
+    page parse_page(const std::string &pagename) {
+        page p;
+        if (auto source = store().find_name(pagename)) {
+            ++stats.cache_hits;
+            p.url = make_normal_page_url(pagename);
+            p.source = *source;
+            if (incremental) {
+                revalidate_page(pagename, p);
+            } else {
+                p.parse_links();
+            }
+        } else {
+            p = page{ make_normal_page_url(pagename) };
+            writer.push(pagename, p, true);
+        }
+        return p;
+    }
+    // incremental mode: ask the server whether the page changed since the last fetch
+    // and re-parse links only when it did, otherwise reuse the stored link list
+    void revalidate_page(const std::string &pagename, page &p) {
+        using rev_table = ::db::parser::schema::tables_::page_revision;
+
+        int64_t fetched_at{}, revision{};
+        std::optional<std::string> links;
+        {
+            auto sel = store().db.select<rev_table, &rev_table::name>(pagename);
+            if (auto i = sel.begin(); i != sel.end()) {
+                auto &r = *i;
+                fetched_at = r.fetched_at;
+                revision = r.revision;
+                links = r.links;
+            }
+        }
+        std::optional<std::string> source;
+        try {
+            source = revalidate_url(p.url, fetched_at);
+        } catch (std::exception &e) {
+            // keep working from the stored copy
+            std::cerr << e.what() << "\n";
+        }
+        // revision check also covers servers that ignore If-Modified-Since
+        if (source && (!revision || parse_revision(*source) != revision)) {
+            ++changed_pages;
+            p.source = std::move(*source);
+            p.parse_links();
+            writer.push(pagename, p, true);
+            return;
+        }
+        // 304, or 200 at the stored revision: the stored copy is current as of now
+        ++unchanged_pages;
+        if (links) {
+            for (auto &&l : split_string(*links, "\n")) {
+                p.links.push_back(urls.intern(l));
+            }
+        } else {
+            // first incremental run over an old db: no stored links yet
+            p.parse_links();
+        }
+        writer.push(pagename, p, false);
+    }
+};
+
+// trains a new dictionary on the stored pages and recompresses all blobs with it
+void compress_db() {
+    using namespace ::db::parser;
+
+    primitives::sqlite::sqlitemgr db{db_file.getValue()};
+    db.create_tables(schema{});
+    std::vector<std::pair<std::string, std::string>> blobs;
+    size_t stored_size{}, total_size{};
+    for (auto &&b : db.select<schema::tables_::blob>()) {
+        stored_size += b.data.size();
+        auto &[hash, source] = blobs.emplace_back(b.hash, codec().decompress(b.data));
+        total_size += source.size();
+    }
+    if (blobs.empty()) {
+        return;
+    }
+    // zstd recommends about 100x dictionary size of samples
+    auto step = std::max<size_t>(1, total_size / (100 * page_codec::dictionary_capacity));
+    std::vector<std::string> samples;
+    for (size_t i = 0; i < blobs.size(); i += step) {
+        samples.push_back(blobs[i].second);
+    }
+    auto dict = page_codec::train(samples);
+    codec().add_dictionary(dict);
+
+    size_t new_size{};
+    auto tr = db.scoped_transaction();
+    auto dict_ins = db.prepared_insert<schema::tables_::dictionary>();
+    dict_ins.insert({ .zstd_id = page_codec::dictionary_id(dict), .data = dict });
+    auto blob_ins = db.prepared_insert<schema::tables_::blob, or_replace{}>();
+    for (auto &&[hash, source] : blobs) {
+        auto c = codec().compress(source);
+        new_size += c.size();
+        blob_ins.insert({ .hash = hash, .data = c });
+    }
+    std::println("blobs: {} -> {} MB ({} MB raw), dictionary {} bytes from {} samples",
+        stored_size / 1024 / 1024, new_size / 1024 / 1024, total_size / 1024 / 1024, dict.size(), samples.size());
+}
+// imports the legacy page table and url request cache into the content-addressed store,
+// identical bodies under different names or urls end up in one blob
+void migrate_legacy_store() {
+    using namespace ::db::parser;
+
+    primitives::sqlite::sqlitemgr db{db_file.getValue()};
+    db.create_tables(schema{});
+    page_store st{db};
+    size_t names{}, url_keys{};
+    auto tr = db.scoped_transaction();
+    for (auto &&p : db.select<schema::tables_::page>()) {
+        st.put_name(p.name, st.put_blob(codec().decompress(p.source)));
+        ++names;
+    }
+    if (fs::exists(cache_db_file.getValue())) {
+        for (auto &&[url, body] : cache().get_all<url_request_cache>()) {
+            st.put_url(url, st.put_blob(codec().decompress(body)));
+            ++url_keys;
+        }
+    }
+    std::println("imported {} names and {} urls, the legacy page table and {} can be dropped now", names, url_keys, cache_db_file.getValue());
+}
+
+// false when interrupted
+bool parse() {
+    // the crawler copies each body out once, cached ones would only hold memory; later stages get the cache back
+    auto cache_capacity = body_cache().capacity();
+    if (!cache_mb.getNumOccurrences()) {
+        body_cache().set_capacity(0);
+    }
+    bool complete;
+    {
+        parser p;
+        complete = p.start();
+    }
+    body_cache().set_capacity(cache_capacity);
+    // after the writer has drained
+    if (!metrics_out.empty()) {
+        stats.write_metrics(metrics_out.getValue());
+    }
+    return complete;
+}
+
@@ -1,8 +1,33 @@
 #!/bin/bash
 
+DB=cppreference2.db
 DIR=cppreference
-for i in `sqlite3 cppreference2.db "select name from page;"`; do
+# sources may be zstd compressed (see --compress-db), each frame names the dictionary it needs
+for id in `sqlite3 $DB "select zstd_id from dictionary;"`; do
+    id="${id%%[[:cntrl:]]}"
+    sqlite3 $DB "select writefile('$DIR.dict.$id', data) from dictionary where zstd_id = $id;" > /dev/null
+done
+for i in `sqlite3 $DB "select name from page_name;"`; do
     i="${i%%[[:cntrl:]]}"
     mkdir -p `dirname $DIR/$i`
-    sqlite3 cppreference2.db "select source from page where name = '$i';" > $DIR/$i.html
+    Z="$DIR/$i.html.zst"
+    sqlite3 $DB "select writefile('$Z', b.data) from page_name n join blob b on b.hash = n.hash where n.name = '$i';" > /dev/null
+    # bodies stored before compression have no zstd magic
+    if [ "`head -c 4 "$Z" | od -An -tx1 | tr -d ' \n'`" != "28b52ffd" ]; then
+        mv "$Z" "$DIR/$i.html"
+        continue
+    fi
+    D=
+    id=`zstd -lv "$Z" 2> /dev/null | sed -n 's/^DictID: *//p'`
+    if [ -n "$id" ] && [ "$id" != 0 ]; then
+        if [ ! -f "$DIR.dict.$id" ]; then
+            echo "$i: dictionary $id is not in $DB" >&2
+            exit 1
+        fi
+        D="-D $DIR.dict.$id"
+    fi
+    if ! zstd -q -d -f --rm $D "$Z" -o "$DIR/$i.html"; then
+        echo "$i: cannot decompress" >&2
+        exit 1
+    fi
 done
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <curl/curl.h>
+
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct http_request {
+    std::string url;
+    std::vector<std::string> headers;
+    long timeout = 90; // seconds
+    // connection settings, make_request() fills them from the global httpSettings
+    std::string proxy;
+    std::string proxy_user;
+    bool ignore_ssl_checks{};
+    bool verbose{};
+};
+struct http_response {
+    long http_code{};
+    std::string response; // decoded body
+    int64_t wire_bytes{}; // body bytes as transferred, before decoding
+    long new_connections{}; // 0 when an open connection was reused
+};
+
+// one curl easy handle per worker thread. The handle keeps its connections open between requests
+// (http/1.1 keep-alive, http/2 over tls) together with dns and tls session caches,
+// and bodies are requested compressed and decoded by curl before we see them.
+struct downloader {
+    struct curl_deleter { void operator()(CURL *p) const { curl_easy_cleanup(p); } };
+    struct slist_deleter { void operator()(curl_slist *p) const { curl_slist_free_all(p); } };
+
+    std::unique_ptr<CURL, curl_deleter> h;
+
+    downloader() {
+        static auto init = curl_global_init(CURL_GLOBAL_DEFAULT);
+        h.reset(curl_easy_init());
+        if (init != CURLE_OK || !h) {
+            throw std::runtime_error{"cannot init curl"};
+        }
+    }
+    static downloader &local() {
+        thread_local downloader d;
+        return d;
+    }
+    // only advertise what this curl build can decode
+    static const char *accept_encoding() {
+        static const auto br = curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_BROTLI;
+        return br ? "gzip, br" : "gzip";
+    }
+
+    http_response get(const http_request &req) {
+        http_response resp;
+        std::unique_ptr<curl_slist, slist_deleter> headers;
+        for (auto &&hdr : req.headers) {
+            headers.reset(curl_slist_append(headers.release(), hdr.c_str()));
+        }
+        auto c = h.get();
+        // options go back to defaults, open connections and caches stay
+        curl_easy_reset(c);
+        curl_easy_setopt(c, CURLOPT_URL, req.url.c_str());
+        curl_easy_setopt(c, CURLOPT_HTTPHEADER, headers.get());
+        curl_easy_setopt(c, CURLOPT_TIMEOUT, req.timeout);
+        curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(c, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(c, CURLOPT_ACCEPT_ENCODING, accept_encoding());
+        if (!req.proxy.empty()) {
+            curl_easy_setopt(c, CURLOPT_PROXY, req.proxy.c_str());
+            if (!req.proxy_user.empty()) {
+                curl_easy_setopt(c, CURLOPT_PROXYUSERPWD, req.proxy_user.c_str());
+            }
+        }
+        if (req.ignore_ssl_checks) {
+            curl_easy_setopt(c, CURLOPT_SSL_VERIFYPEER, 0L);
+            curl_easy_setopt(c, CURLOPT_SSL_VERIFYHOST, 0L);
+        }
+        curl_easy_setopt(c, CURLOPT_VERBOSE, req.verbose ? 1L : 0L);
+        curl_easy_setopt(c, CURLOPT_WRITEDATA, &resp.response);
+        curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, +[](char *p, size_t size, size_t n, void *out) {
+            ((std::string *)out)->append(p, size * n);
+            return size * n;
+        });
+        if (auto r = curl_easy_perform(c); r != CURLE_OK) {
+            throw std::runtime_error{std::format("url = {}, curl error: {}", req.url, curl_easy_strerror(r))};
+        }
+        curl_off_t wire{};
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &resp.http_code);
+        curl_easy_getinfo(c, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+        curl_easy_getinfo(c, CURLINFO_NUM_CONNECTS, &resp.new_connections);
+        resp.wire_bytes = wire;
+        return resp;
+    }
+};
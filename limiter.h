@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum class fetch_outcome {
+    ok, // any answer from a healthy server, including 404
+    overloaded, // 429, 5xx or transport error
+};
+
+// AIMD limit on in-flight requests to one host.
+// The limit grows by one per round trip while latency stays close to the lowest seen one
+// and shrinks multiplicatively on throttling, server errors or queueing latency,
+// at most once per round trip so one burst of errors does not collapse it to the minimum.
+struct aimd_limiter {
+    using clock = std::chrono::steady_clock;
+
+    static inline constexpr double min_limit = 1;
+    static inline constexpr double backoff = 0.7;
+    static inline constexpr double latency_tolerance = 2; // of the baseline
+    static inline constexpr double baseline_drift = 1.001; // lets the baseline follow a slower server
+
+    double limit;
+    double max_limit;
+    bool adaptive;
+    size_t in_flight{};
+    double baseline_us{}; // lowest latency, slowly forgotten
+    double smoothed_us{};
+    clock::time_point last_decrease{};
+    std::mutex m;
+    std::condition_variable cv;
+
+    aimd_limiter(double initial, double max_limit, bool adaptive = true)
+        : limit{std::clamp(initial, min_limit, max_limit)}, max_limit{max_limit}, adaptive{adaptive} {
+    }
+
+    void acquire() {
+        std::unique_lock lk{m};
+        cv.wait(lk, [&]{return in_flight < (size_t)limit;});
+        ++in_flight;
+    }
+    void release(clock::duration d, fetch_outcome r) {
+        {
+            std::unique_lock lk{m};
+            // grow only when the limit is what actually holds us back
+            bool saturated = in_flight >= (size_t)limit;
+            --in_flight;
+            if (adaptive) {
+                update(d, r, saturated);
+            }
+        }
+        cv.notify_all();
+    }
+    double current_limit() {
+        std::unique_lock lk{m};
+        return limit;
+    }
+
+private:
+    void update(clock::duration d, fetch_outcome r, bool saturated) {
+        auto us = (double)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        if (r == fetch_outcome::overloaded) {
+            decrease();
+            return;
+        }
+        baseline_us = baseline_us ? std::min(baseline_us * baseline_drift, us) : us;
+        smoothed_us = smoothed_us ? smoothed_us * 0.9 + us * 0.1 : us;
+        if (smoothed_us > baseline_us * latency_tolerance) {
+            decrease();
+        } else if (saturated) {
+            limit = std::min(max_limit, limit + 1 / limit);
+        }
+    }
+    void decrease() {
+        auto now = clock::now();
+        if (now - last_decrease < std::chrono::microseconds{(int64_t)smoothed_us}) {
+            return;
+        }
+        last_decrease = now;
+        limit = std::max(min_limit, limit * backoff);
+    }
+};
+
+// requests per second cap, 0 is unlimited. Tokens may go negative: callers reserve a slot in the future and sleep until it.
+struct token_bucket {
+    using clock = std::chrono::steady_clock;
+
+    double rate;
+    double burst;
+    double tokens;
+    clock::time_point last{clock::now()};
+    std::mutex m;
+
+    token_bucket(double rate) : rate{rate}, burst{std::max(1., rate)}, tokens{burst} {
+    }
+
+    void acquire() {
+        if (rate <= 0) {
+            return;
+        }
+        std::chrono::duration<double> wait{};
+        {
+            std::unique_lock lk{m};
+            auto now = clock::now();
+            tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+            last = now;
+            tokens -= 1;
+            if (tokens < 0) {
+                wait = std::chrono::duration<double>{-tokens / rate};
+            }
+        }
+        if (wait.count() > 0) {
+            std::this_thread::sleep_for(wait);
+        }
+    }
+};
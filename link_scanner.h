@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINK_SCANNER_SSE2
+#endif
+
+// DOM-free <a href> scanner: yields href values as views into the source without allocations.
+// Comments, <script> and <style> bodies are skipped like an html parser would do.
+struct link_scanner {
+    std::string_view s;
+
+    // position of the next c at or after pos, or s.size()
+    size_t find_byte(size_t pos, char c) const {
+        if (pos >= s.size()) {
+            return s.size();
+        }
+#ifdef LINK_SCANNER_SSE2
+        auto needle = _mm_set1_epi8(c);
+        for (; pos + 16 <= s.size(); pos += 16) {
+            auto v = _mm_loadu_si128((const __m128i *)(s.data() + pos));
+            if (auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle))) {
+                return pos + std::countr_zero((unsigned)mask);
+            }
+        }
+#endif
+        if (auto p = (const char *)memchr(s.data() + pos, c, s.size() - pos)) {
+            return p - s.data();
+        }
+        return s.size();
+    }
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+    static char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+    bool starts_with_i(size_t pos, std::string_view prefix) const {
+        if (s.size() - pos < prefix.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            if (lower(s[pos + i]) != prefix[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // tag name at pos is complete
+    bool is_tag_end(size_t pos) const {
+        return pos >= s.size() || is_space(s[pos]) || s[pos] == '>' || s[pos] == '/';
+    }
+    // position right after the closing tag, case insensitive
+    size_t skip_raw_text(size_t pos, std::string_view closing) const {
+        while ((pos = find_byte(pos, '<')) < s.size()) {
+            if (starts_with_i(pos, closing)) {
+                return pos + closing.size();
+            }
+            ++pos;
+        }
+        return s.size();
+    }
+
+    // f(std::string_view href) for every <a> with a href attribute
+    void for_each(auto &&f) const {
+        size_t pos = 0;
+        while ((pos = find_byte(pos, '<')) < s.size()) {
+            ++pos;
+            if (s.substr(pos).starts_with("!--")) {
+                auto e = s.find("-->", pos + 3);
+                pos = e == std::string_view::npos ? s.size() : e + 3;
+                continue;
+            }
+            if (starts_with_i(pos, "script") && is_tag_end(pos + 6)) {
+                pos = skip_raw_text(pos, "</script");
+                continue;
+            }
+            if (starts_with_i(pos, "style") && is_tag_end(pos + 5)) {
+                pos = skip_raw_text(pos, "</style");
+                continue;
+            }
+            if (pos + 1 < s.size() && lower(s[pos]) == 'a' && is_space(s[pos + 1])) {
+                pos = parse_attributes(pos + 1, f);
+            }
+        }
+    }
+    // returns position after the tag
+    size_t parse_attributes(size_t pos, auto &&f) const {
+        bool found{};
+        while (pos < s.size()) {
+            while (pos < s.size() && (is_space(s[pos]) || s[pos] == '/')) {
+                ++pos;
+            }
+            if (pos >= s.size() || s[pos] == '>') {
+                return pos + 1;
+            }
+            auto name_begin = pos;
+            while (pos < s.size() && !is_space(s[pos]) && s[pos] != '=' && s[pos] != '>' && s[pos] != '/') {
+                ++pos;
+            }
+            auto name = s.substr(name_begin, pos - name_begin);
+            while (pos < s.size() && is_space(s[pos])) {
+                ++pos;
+            }
+            if (pos >= s.size() || s[pos] != '=') {
+                continue; // attribute without value
+            }
+            ++pos;
+            while (pos < s.size() && is_space(s[pos])) {
+                ++pos;
+            }
+            std::string_view value;
+            if (pos < s.size() && (s[pos] == '"' || s[pos] == '\'')) {
+                auto e = find_byte(pos + 1, s[pos]);
+                value = s.substr(pos + 1, e - pos - 1);
+                pos = e + 1;
+            } else {
+                auto b = pos;
+                while (pos < s.size() && !is_space(s[pos]) && s[pos] != '>') {
+                    ++pos;
+                }
+                value = s.substr(b, pos - b);
+            }
+            // first href wins, like in the dom
+            if (!found && name.size() == 4 && starts_with_i(name_begin, "href")) {
+                found = true;
+                f(value);
+            }
+        }
+        return pos;
+    }
+};
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// size bounded lru of shared immutable bodies, split into shards with their own locks
+// so workers rarely contend. Readers keep their shared_ptr alive after eviction.
+struct sharded_lru_cache {
+    using value_type = std::shared_ptr<const std::string>;
+
+    struct shard {
+        std::mutex m;
+        std::list<std::pair<std::string, value_type>> lru; // most recent first
+        std::unordered_map<std::string_view, decltype(lru)::iterator> index; // views into lru keys
+        size_t bytes{};
+    };
+
+    static inline constexpr size_t nshards = 16;
+
+    std::vector<shard> shards{nshards};
+    std::atomic<size_t> shard_capacity;
+    std::atomic<int64_t> hits{};
+    std::atomic<int64_t> misses{};
+
+    sharded_lru_cache(size_t capacity) : shard_capacity{capacity / nshards} {
+    }
+
+    bool enabled() const {
+        return shard_capacity > 0;
+    }
+    size_t capacity() const {
+        return shard_capacity * nshards;
+    }
+    // shrinking evicts right away, 0 drops everything and disables the cache
+    void set_capacity(size_t capacity) {
+        shard_capacity = capacity / nshards;
+        for (auto &s : shards) {
+            std::unique_lock lk{s.m};
+            evict(s);
+        }
+    }
+    value_type find(const std::string &key) {
+        if (!enabled()) {
+            return {};
+        }
+        auto &s = get_shard(key);
+        std::unique_lock lk{s.m};
+        auto i = s.index.find(key);
+        if (i == s.index.end()) {
+            ++misses;
+            return {};
+        }
+        s.lru.splice(s.lru.begin(), s.lru, i->second);
+        ++hits;
+        return i->second->second;
+    }
+    void insert(const std::string &key, value_type v) {
+        auto size = key.size() + v->size();
+        if (!enabled() || size > shard_capacity) {
+            return;
+        }
+        auto &s = get_shard(key);
+        std::unique_lock lk{s.m};
+        if (auto i = s.index.find(key); i != s.index.end()) {
+            s.bytes -= i->second->first.size() + i->second->second->size();
+            s.lru.erase(i->second);
+            s.index.erase(i);
+        }
+        s.lru.emplace_front(key, std::move(v));
+        s.index.emplace(s.lru.front().first, s.lru.begin());
+        s.bytes += size;
+        evict(s);
+    }
+
+private:
+    void evict(shard &s) {
+        while (s.bytes > shard_capacity) {
+            auto &[k, old] = s.lru.back();
+            s.bytes -= k.size() + old->size();
+            s.index.erase(k);
+            s.lru.pop_back();
+        }
+    }
+    shard &get_shard(const std::string &key) {
+        return shards[std::hash<std::string>{}(key) % nshards];
+    }
+};
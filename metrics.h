@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <string>
+#include <vector>
+
+// lock-free log scale histogram of durations: 4 buckets per power of two microseconds (about 19% resolution)
+struct latency_histogram {
+    static inline constexpr int buckets_per_octave = 4;
+    static inline constexpr int nbuckets = 30 * buckets_per_octave + 1; // up to 2^30 us, the last one takes the rest
+
+    std::array<std::atomic<int64_t>, nbuckets> counts{};
+    std::atomic<int64_t> total{};
+    std::atomic<int64_t> sum_us{};
+
+    static int bucket(int64_t us) {
+        if (us <= 1) {
+            return 0;
+        }
+        return std::min<int>(nbuckets - 1, std::ceil(std::log2((double)us) * buckets_per_octave));
+    }
+    static double upper_bound_us(int i) {
+        return std::exp2((double)i / buckets_per_octave);
+    }
+
+    void add(std::chrono::steady_clock::duration d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        ++counts[bucket(us)];
+        ++total;
+        sum_us += us;
+    }
+    // upper bound of the bucket holding the p-th sample
+    double percentile_ms(double p) const {
+        auto n = total.load();
+        if (!n) {
+            return 0;
+        }
+        auto target = std::max<int64_t>(1, std::ceil(p * n));
+        int64_t seen{};
+        for (int i = 0; i < nbuckets; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                return upper_bound_us(i) / 1000;
+            }
+        }
+        return upper_bound_us(nbuckets - 1) / 1000;
+    }
+};
+
+// snapshot of named values and histograms, rendered as prometheus text exposition or json
+struct metrics_output {
+    struct value {
+        std::string name;
+        std::string help;
+        double v;
+        bool counter;
+    };
+    struct histogram {
+        std::string name;
+        std::string help;
+        const latency_histogram *h;
+    };
+
+    std::vector<value> values;
+    std::vector<histogram> histograms;
+
+    void counter(std::string name, std::string help, double v) {
+        values.push_back({std::move(name), std::move(help), v, true});
+    }
+    void gauge(std::string name, std::string help, double v) {
+        values.push_back({std::move(name), std::move(help), v, false});
+    }
+    void add(std::string name, std::string help, const latency_histogram &h) {
+        histograms.push_back({std::move(name), std::move(help), &h});
+    }
+
+    std::string prometheus() const {
+        std::string s;
+        for (auto &&v : values) {
+            s += std::format("# HELP {} {}\n# TYPE {} {}\n{} {}\n", v.name, v.help, v.name, v.counter ? "counter" : "gauge", v.name, v.v);
+        }
+        for (auto &&[name, help, h] : histograms) {
+            s += std::format("# HELP {} {}\n# TYPE {} histogram\n", name, help, name);
+            int64_t cumulative{};
+            for (int i = 0; i < latency_histogram::nbuckets; ++i) {
+                cumulative += h->counts[i];
+                // one bucket per octave is plenty for dashboards
+                if (i % latency_histogram::buckets_per_octave == 0) {
+                    s += std::format("{}_bucket{{le=\"{}\"}} {}\n", name, latency_histogram::upper_bound_us(i) / 1e6, cumulative);
+                }
+            }
+            s += std::format("{}_bucket{{le=\"+Inf\"}} {}\n{}_sum {}\n{}_count {}\n", name, h->total.load(), name, h->sum_us / 1e6, name, h->total.load());
+        }
+        return s;
+    }
+    std::string json() const {
+        std::string s = "{\n";
+        for (auto &&v : values) {
+            s += std::format("  \"{}\": {},\n", v.name, v.v);
+        }
+        s += "  \"histograms\": {";
+        for (bool first = true; auto &&[name, help, h] : histograms) {
+            s += std::format("{}\n    \"{}\": {{\"count\": {}, \"sum_seconds\": {}, \"p50_ms\": {}, \"p90_ms\": {}, \"p99_ms\": {}}}",
+                first ? "" : ",", name, h->total.load(), h->sum_us / 1e6, h->percentile_ms(0.5), h->percentile_ms(0.9), h->percentile_ms(0.99));
+            first = false;
+        }
+        s += "\n  }\n}\n";
+        return s;
+    }
+};
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <zdict.h>
+#include <zstd.h>
+
+#include <format>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// zstd compression of stored page bodies with dictionaries trained on the corpus
+// (cppreference pages share the same skin, navbars and scripts).
+// Values without the zstd frame magic are returned as is, so uncompressed dbs keep working.
+struct page_codec {
+    static inline constexpr auto compression_level = 9;
+    static inline constexpr auto dictionary_capacity = 112 * 1024;
+
+    struct cctx_deleter { void operator()(ZSTD_CCtx *p) const { ZSTD_freeCCtx(p); } };
+    struct dctx_deleter { void operator()(ZSTD_DCtx *p) const { ZSTD_freeDCtx(p); } };
+    struct cdict_deleter { void operator()(ZSTD_CDict *p) const { ZSTD_freeCDict(p); } };
+    struct ddict_deleter { void operator()(ZSTD_DDict *p) const { ZSTD_freeDDict(p); } };
+
+    // frames remember their dictionary id, so all known dictionaries stay loaded for reading
+    std::map<unsigned, std::unique_ptr<ZSTD_DDict, ddict_deleter>> ddicts;
+    std::unique_ptr<ZSTD_CDict, cdict_deleter> cdict; // newest dictionary, used for writing
+
+    static bool is_compressed(std::string_view s) {
+        return s.size() >= 4 && ZSTD_getFrameContentSize(s.data(), s.size()) != ZSTD_CONTENTSIZE_ERROR;
+    }
+    static unsigned dictionary_id(std::string_view dict) {
+        return ZDICT_getDictID(dict.data(), dict.size());
+    }
+    static std::string train(const std::vector<std::string> &samples) {
+        std::string buf;
+        std::vector<size_t> sizes;
+        for (auto &&s : samples) {
+            buf += s;
+            sizes.push_back(s.size());
+        }
+        std::string dict(dictionary_capacity, 0);
+        auto r = ZDICT_trainFromBuffer(dict.data(), dict.size(), buf.data(), sizes.data(), sizes.size());
+        if (ZDICT_isError(r)) {
+            throw std::runtime_error{std::format("cannot train dictionary: {}", ZDICT_getErrorName(r))};
+        }
+        dict.resize(r);
+        return dict;
+    }
+
+    // not thread safe, call before workers start
+    void add_dictionary(const std::string &dict) {
+        ddicts[dictionary_id(dict)].reset(ZSTD_createDDict(dict.data(), dict.size()));
+        cdict.reset(ZSTD_createCDict(dict.data(), dict.size(), compression_level));
+    }
+
+    std::string compress(std::string_view s) const {
+        thread_local std::unique_ptr<ZSTD_CCtx, cctx_deleter> ctx{ZSTD_createCCtx()};
+        std::string out(ZSTD_compressBound(s.size()), 0);
+        auto r = cdict
+            ? ZSTD_compress_usingCDict(ctx.get(), out.data(), out.size(), s.data(), s.size(), cdict.get())
+            : ZSTD_compressCCtx(ctx.get(), out.data(), out.size(), s.data(), s.size(), compression_level);
+        if (ZSTD_isError(r)) {
+            throw std::runtime_error{std::format("cannot compress: {}", ZSTD_getErrorName(r))};
+        }
+        out.resize(r);
+        return out;
+    }
+    std::string decompress(const std::string &s) const {
+        if (!is_compressed(s)) {
+            return s;
+        }
+        auto size = ZSTD_getFrameContentSize(s.data(), s.size());
+        if (size == ZSTD_CONTENTSIZE_UNKNOWN) {
+            throw std::runtime_error{"cannot decompress: unknown content size"};
+        }
+        thread_local std::unique_ptr<ZSTD_DCtx, dctx_deleter> ctx{ZSTD_createDCtx()};
+        std::string out(size, 0);
+        size_t r;
+        if (auto id = ZSTD_getDictID_fromFrame(s.data(), s.size())) {
+            auto i = ddicts.find(id);
+            if (i == ddicts.end()) {
+                throw std::runtime_error{std::format("cannot decompress: unknown dictionary {}", id)};
+            }
+            r = ZSTD_decompress_usingDDict(ctx.get(), out.data(), out.size(), s.data(), s.size(), i->second.get());
+        } else {
+            r = ZSTD_decompressDCtx(ctx.get(), out.data(), out.size(), s.data(), s.size());
+        }
+        if (ZSTD_isError(r)) {
+            throw std::runtime_error{std::format("cannot decompress: {}", ZSTD_getErrorName(r))};
+        }
+        out.resize(r);
+        return out;
+    }
+};
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+// generated pages are sequences of these elements, see cpp_traverser and the renderers
+
+namespace page_elements {
+
+struct page {
+    std::string value;
+};
+struct title {
+    std::string value;
+};
+struct header {
+    int level;
+};
+struct header_end {};
+struct link {
+    std::string value;
+};
+struct link_end{};
+
+struct code{};
+struct code_end {};
+
+struct code_tag {};
+struct code_tag_end {};
+
+struct table{};
+struct table_end{};
+struct next_row {
+    int rowspan;
+};
+struct next_col {
+    int colspan;
+};
+
+struct paragraph{};
+struct cite {};
+
+struct bold {};
+struct monospace {};
+struct italic {};
+#undef small
+struct small {};
+struct abbr {};
+
+struct ul {};
+struct ol {};
+struct li {};
+
+struct dl {};
+struct dd {};
+struct dt {};
+
+struct blockquote {};
+struct img {};
+struct caption {};
+struct sub {};
+struct sup {};
+
+struct template_ {};
+struct br {};
+
+enum class element_kind {
+    open, // element{}, then the children
+    leaf, // element{}, children are dropped
+    block, // element{}, the children, element_end{} and an empty line
+};
+
+// html tags converted to one element each. This is the single list behind the parser tag table
+// (cppreference_parser.cpp) and it is checked against the structs above.
+// Tags that need attributes or classes (a, div, span, h1-h6, tr, th, td...) have own parser handlers.
+#define PAGE_ELEMENT_TAGS(X) \
+    X(p, paragraph, open) \
+    X(table, table, block) \
+    X(cite, cite, open) \
+    X(b, bold, open) \
+    X(strong, bold, open) \
+    X(small, small, open) \
+    X(i, italic, open) \
+    X(tt, monospace, open) \
+    X(br, br, leaf) \
+    X(abbr, abbr, open) \
+    X(ul, ul, open) \
+    X(ol, ol, open) \
+    X(li, li, open) \
+    X(dl, dl, open) \
+    X(dd, dd, open) \
+    X(dt, dt, open) \
+    X(blockquote, blockquote, open) \
+    X(img, img, open) \
+    X(caption, caption, open) \
+    X(sub, sub, open) \
+    X(sup, sup, open)
+
+#define PAGE_ELEMENT_CHECK_open(e) static_assert(std::is_class_v<e>);
+#define PAGE_ELEMENT_CHECK_leaf(e) static_assert(std::is_class_v<e>);
+#define PAGE_ELEMENT_CHECK_block(e) static_assert(std::is_class_v<e> && std::is_class_v<e##_end>);
+#define PAGE_ELEMENT_CHECK(tag, element, kind) PAGE_ELEMENT_CHECK_##kind(element)
+PAGE_ELEMENT_TAGS(PAGE_ELEMENT_CHECK)
+#undef PAGE_ELEMENT_CHECK
+#undef PAGE_ELEMENT_CHECK_block
+#undef PAGE_ELEMENT_CHECK_leaf
+#undef PAGE_ELEMENT_CHECK_open
+
+} // namespace page_elements
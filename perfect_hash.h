@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+
+// string_view -> V map built at compile time, a lookup is two hashes, one probe and one compare.
+// Hash and displace: keys are split into buckets by one hash, then every bucket gets its own seed
+// that places all its keys into free slots, biggest buckets first.
+template <typename V, size_t N>
+struct perfect_hash_map {
+    using value_type = std::pair<std::string_view, V>;
+
+    static inline constexpr size_t nslots = std::bit_ceil(N * 2);
+    static inline constexpr size_t nbuckets = (N + 3) / 4;
+
+    std::array<value_type, N> entries;
+    std::array<uint32_t, nbuckets> seeds{};
+    std::array<uint16_t, nslots> slots{}; // entry index + 1, 0 is empty
+
+    static constexpr uint64_t hash(std::string_view s, uint64_t seed) {
+        // fnv-1a
+        uint64_t h = 0xcbf29ce484222325 ^ (seed * 0x9e3779b97f4a7c15);
+        for (unsigned char c : s) {
+            h = (h ^ c) * 0x100000001b3;
+        }
+        return h ^ (h >> 32);
+    }
+
+    consteval perfect_hash_map(const std::array<value_type, N> &in) : entries{in} {
+        static_assert(N < 0xffff);
+        std::array<size_t, N> bucket{}, order{}, bucket_size{};
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (entries[i].first == entries[j].first) {
+                    throw "duplicate key";
+                }
+            }
+            bucket[i] = hash(entries[i].first, 0) % nbuckets;
+            ++bucket_size[bucket[i]];
+            order[i] = i;
+        }
+        std::ranges::sort(order, [&](auto a, auto b) {
+            return std::pair{bucket_size[bucket[b]], bucket[a]} < std::pair{bucket_size[bucket[a]], bucket[b]};
+        });
+        for (size_t b = 0; b < N; b += bucket_size[bucket[order[b]]]) {
+            auto keys = std::span{order}.subspan(b, bucket_size[bucket[order[b]]]);
+            for (uint32_t seed = 1;; ++seed) {
+                std::array<size_t, N> taken{};
+                size_t ntaken{};
+                auto fits = std::ranges::all_of(keys, [&](auto i) {
+                    auto s = hash(entries[i].first, seed) % nslots;
+                    if (slots[s] || std::ranges::find(taken.begin(), taken.begin() + ntaken, s) != taken.begin() + ntaken) {
+                        return false;
+                    }
+                    taken[ntaken++] = s;
+                    return true;
+                });
+                if (fits) {
+                    for (size_t k = 0; k < keys.size(); ++k) {
+                        slots[taken[k]] = keys[k] + 1;
+                    }
+                    seeds[bucket[keys[0]]] = seed;
+                    break;
+                }
+            }
+        }
+    }
+
+    // position of the key in the initializer, -1 when missing; usable as a dense id
+    constexpr int index_of(std::string_view k) const {
+        auto i = slots[hash(k, seeds[hash(k, 0) % nbuckets]) % nslots];
+        if (!i || entries[i - 1].first != k) {
+            return -1;
+        }
+        return i - 1;
+    }
+    constexpr const V *find(std::string_view k) const {
+        auto i = index_of(k);
+        return i < 0 ? nullptr : &entries[i].second;
+    }
+    constexpr size_t size() const {
+        return N;
+    }
+};
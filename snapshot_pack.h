@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// single file crawl snapshot for offline stages and for moving crawls between machines.
+// Bodies are stored uncompressed and deduplicated, so readers get string_views straight into the mapping.
+//
+// layout: [bodies, each followed by its hash][keys][padding][entries sorted by kind, key][footer]
+struct snapshot_pack {
+    static inline constexpr uint64_t magic = 0x32'4b'43'41'50'52'50'43; // "CPRPACK2"
+
+    enum kind : uint32_t {
+        name,
+        url,
+        wikitext,
+    };
+    struct entry {
+        uint64_t key_offset;
+        uint64_t body_offset;
+        uint64_t body_size;
+        uint64_t hash_offset; // sha256 of the body, lets readers skip unchanged bodies without touching them
+        uint32_t key_size;
+        uint32_t hash_size;
+        uint32_t kind;
+        uint32_t reserved;
+    };
+    struct footer {
+        uint64_t entries_offset;
+        uint64_t count;
+        uint64_t magic;
+    };
+
+    // appends bodies as they come, the index goes to the end in finish()
+    struct writer {
+        std::ofstream out;
+        uint64_t pos{};
+        struct body_ref {
+            uint64_t offset;
+            uint64_t size;
+            uint64_t hash_offset;
+            uint32_t hash_size;
+        };
+        std::vector<std::tuple<uint32_t, std::string, body_ref>> index; // kind, key, body
+        std::unordered_map<std::string, body_ref> written; // by body hash
+
+        writer(const std::filesystem::path &fn) : out{fn, std::ios::binary | std::ios::trunc} {
+            if (!out) {
+                throw std::runtime_error{std::format("cannot create pack {}", fn.string())};
+            }
+        }
+        // hash is the sha256 of the body, get_body() is called only for bodies not written yet
+        void add(kind k, std::string key, const std::string &hash, auto &&get_body) {
+            auto i = written.find(hash);
+            if (i == written.end()) {
+                body_ref b{ .offset = pos };
+                b.size = write(get_body());
+                b.hash_offset = pos;
+                b.hash_size = (uint32_t)write(hash);
+                i = written.emplace(hash, b).first;
+            }
+            index.emplace_back(k, std::move(key), i->second);
+        }
+        void finish() {
+            std::ranges::sort(index, {}, [](auto &&e) { return std::tie(std::get<0>(e), std::get<1>(e)); });
+            std::vector<entry> entries;
+            entries.reserve(index.size());
+            for (auto &&[k, key, b] : index) {
+                entries.push_back({ .key_offset = pos, .body_offset = b.offset, .body_size = b.size, .hash_offset = b.hash_offset,
+                    .key_size = (uint32_t)key.size(), .hash_size = b.hash_size, .kind = k });
+                write(key);
+            }
+            write(std::string(-pos % alignof(entry), 0));
+            footer f{ .entries_offset = pos, .count = entries.size(), .magic = magic };
+            write({(const char *)entries.data(), entries.size() * sizeof(entry)});
+            write({(const char *)&f, sizeof(f)});
+            out.close();
+            if (!out) {
+                throw std::runtime_error{"cannot write pack"};
+            }
+        }
+
+    private:
+        uint64_t write(std::string_view s) {
+            out.write(s.data(), s.size());
+            pos += s.size();
+            return s.size();
+        }
+    };
+
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+    const char *base{};
+    std::span<const entry> entries;
+
+    snapshot_pack(const std::filesystem::path &fn)
+        : file{fn.string().c_str(), boost::interprocess::read_only}, region{file, boost::interprocess::read_only} {
+        base = (const char *)region.get_address();
+        footer f;
+        if (region.get_size() < sizeof(f)) {
+            throw std::runtime_error{std::format("bad pack {}", fn.string())};
+        }
+        memcpy(&f, base + region.get_size() - sizeof(f), sizeof(f));
+        if (f.magic != magic || f.entries_offset + f.count * sizeof(entry) + sizeof(f) != region.get_size()) {
+            throw std::runtime_error{std::format("bad pack {}", fn.string())};
+        }
+        entries = {(const entry *)(base + f.entries_offset), f.count};
+        region.advise(boost::interprocess::mapped_region::advice_willneed);
+    }
+
+    std::string_view key(const entry &e) const {
+        return {base + e.key_offset, e.key_size};
+    }
+    std::string_view body(const entry &e) const {
+        return {base + e.body_offset, e.body_size};
+    }
+    std::string_view hash(const entry &e) const {
+        return {base + e.hash_offset, e.hash_size};
+    }
+    // all entries of one kind, sorted by key
+    std::span<const entry> range(kind k) const {
+        auto [b, e] = std::ranges::equal_range(entries, (uint32_t)k, {}, &entry::kind);
+        return {b, e};
+    }
+    // entries of one kind whose keys start with prefix
+    std::span<const entry> range(kind k, std::string_view prefix) const {
+        auto r = range(k);
+        auto b = std::ranges::lower_bound(r, prefix, {}, [&](auto &&e) { return key(e); });
+        auto e = std::ranges::find_if(b, r.end(), [&](auto &&e) { return !key(e).starts_with(prefix); });
+        return {b, e};
+    }
+    std::optional<std::string_view> find(kind k, std::string_view what) const {
+        auto r = range(k);
+        auto i = std::ranges::lower_bound(r, what, {}, [&](auto &&e) { return key(e); });
+        if (i == r.end() || key(*i) != what) {
+            return {};
+        }
+        return body(*i);
+    }
+};
@@ -0,0 +1,325 @@
+# -*- coding: utf-8 -*-
+
+# local stand-in for cppreference.com, serves pages from a crawl snapshot (cppreference.db or legacy cache.db)
+#
+#   python standin_server.py --db cppreference.db --port 8080 --modified cpp/header,cpp/vector
+#   cppreference_parser --base-url http://127.0.0.1:8080 --incremental
+#   crawl_bench --base-url http://127.0.0.1:8080
+#
+# every page reports the snapshot time as Last-Modified and answers conditional requests with 304,
+# pages listed in --modified look as if they were edited after the snapshot
+# --latency/--jitter (ms) delay every response, --error-rate answers that share of requests with 503
+# --max-concurrent and --max-rps simulate a throttling server: requests over the limits get 429 with Retry-After
+# bodies are sent gzip (or br with the brotli module) compressed when the client asks for it, connections are kept alive;
+# --identity and --no-keep-alive turn that off to measure the difference
+# wikitext is served from the wikitext table or the textarea of stored edit pages for --wikitext crawls:
+#   /index.php?title=T&action=raw and /api.php?action=query&prop=revisions&titles=A|B (up to 50 titles, formatversion=2 json)
+# /api.php?action=query&list=allpages&apnamespace=N&aplimit=500&apcontinue=T lists the snapshot titles for --allpages
+# zstd compressed snapshots (see --compress-db) need the zstandard module and --dictionaries pointing to the crawl db
+
+import argparse
+import bisect
+import email.utils
+import gzip
+import html
+import json
+import os
+import random
+import re
+import sqlite3
+import threading
+import time
+from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
+from urllib.parse import parse_qs, unquote, urlsplit
+
+def make_path(key):
+    u = urlsplit(key)
+    if u.scheme:
+        return u.path + ('?' + u.query if u.query else '')
+    return '/' + key
+
+ZSTD_MAGIC = b'\x28\xb5\x2f\xfd'
+
+def make_decompressor(fn):
+    dicts = {}
+    try:
+        import zstandard
+        for (data,) in sqlite3.connect(fn).execute('select data from dictionary'):
+            d = zstandard.ZstdCompressionDict(data)
+            dicts[d.dict_id()] = d
+    except (ImportError, sqlite3.Error):
+        return lambda v: v
+    def decompress(v):
+        if not v.startswith(ZSTD_MAGIC):
+            return v
+        d = dicts.get(zstandard.get_frame_parameters(v).dict_id)
+        return zstandard.ZstdDecompressor(dict_data=d).decompress(v)
+    return decompress
+
+def load_snapshot(fn, decompress):
+    load = lambda v: decompress(v.encode('utf-8') if isinstance(v, str) else v)
+    pages = {}
+    db = sqlite3.connect(fn)
+    tables = {t for (t,) in db.execute("select name from sqlite_master where type = 'table'")}
+    if 'blob' in tables:
+        # content-addressed store, identical bodies are shared
+        blobs = {h: load(v) for h, v in db.execute('select hash, data from blob')}
+        for k, h in db.execute('select url, hash from page_url union all select name, hash from page_name'):
+            if h in blobs:
+                pages.setdefault(make_path(k), blobs[h])
+        return pages
+    for t in tables:
+        cols = [c[1] for c in db.execute(f'pragma table_info("{t}")')]
+        if 'name' in cols and 'source' in cols:
+            q = f'select name, source from "{t}"'
+        elif 'url_request_cache' in t:
+            k, v = ('key', 'value') if 'key' in cols and 'value' in cols else cols[-2:]
+            q = f'select "{k}", "{v}" from "{t}"'
+        else:
+            continue
+        for k, v in db.execute(q):
+            pages.setdefault(make_path(k), load(v))
+    return pages
+
+EDIT_KEY = re.compile(r'^/index\.php\?title=(.*)&action=edit$')
+TEXTAREA = re.compile(rb'<textarea[^>]*name="wpTextbox1"[^>]*>(.*?)</textarea>', re.S)
+REVISION = re.compile(rb'"wgCurRevisionId":(\d+)')
+
+def load_wikitext(fn, pages, decompress):
+    # title -> (revision, wikitext bytes)
+    texts = {}
+    for path, body in pages.items():
+        m = EDIT_KEY.match(path)
+        t = m and TEXTAREA.search(body)
+        if t:
+            text = html.unescape(t.group(1).decode('utf-8'))
+            # like browsers, drop the newline right after <textarea>
+            text = text[1:] if text.startswith('\n') else text
+            r = REVISION.search(body)
+            texts[unquote(m.group(1))] = (int(r.group(1)) if r else 0, text.encode('utf-8'))
+    db = sqlite3.connect(fn)
+    if db.execute("select 1 from sqlite_master where type = 'table' and name = 'wikitext'").fetchone():
+        for name, revision, text in db.execute('select name, revision, text from wikitext'):
+            texts[name] = (revision, decompress(text.encode('utf-8') if isinstance(text, str) else text))
+    return texts
+
+NAMESPACES = {1: 'Talk', 2: 'User', 3: 'User talk', 4: 'Cppreference', 6: 'File', 8: 'MediaWiki', 10: 'Template', 11: 'Template talk', 14: 'Category'}
+
+def list_titles(pages, wikitext):
+    # ns -> sorted titles
+    titles = {t.replace('_', ' ') for t in wikitext}
+    for path in pages:
+        if not path.startswith('/index.php') and not path.startswith('/api.php'):
+            titles.add(unquote(path[1:]).replace('_', ' '))
+    by_ns = {}
+    prefixes = {name + ':': ns for ns, name in NAMESPACES.items()}
+    for t in titles:
+        prefix = t.split(':', 1)[0] + ':' if ':' in t else ''
+        by_ns.setdefault(prefixes.get(prefix.replace('_', ' '), 0), []).append(t)
+    return {ns: sorted(v) for ns, v in by_ns.items()}
+
+def modify(body):
+    # bump revision so the crawler sees a real edit
+    body = re.sub(rb'"wgCurRevisionId":(\d+)', lambda m: b'"wgCurRevisionId":%d' % (int(m.group(1)) + 1), body)
+    return body + b'\n<!-- modified by standin_server -->\n'
+
+def make_token_bucket(rate):
+    # called under the server lock
+    if rate <= 0:
+        return lambda: True
+    state = {'tokens': max(1.0, rate), 'last': time.monotonic()}
+    def take():
+        now = time.monotonic()
+        state['tokens'] = min(max(1.0, rate), state['tokens'] + (now - state['last']) * rate)
+        state['last'] = now
+        if state['tokens'] < 1:
+            return False
+        state['tokens'] -= 1
+        return True
+    return take
+
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
+def accepted_encoding(header):
+    codings = {c.split(';')[0].strip().lower() for c in (header or '').split(',')}
+    if brotli and 'br' in codings:
+        return 'br'
+    if 'gzip' in codings:
+        return 'gzip'
+    return None
+
+def encode(s, path, body, coding):
+    # pages are compressed once, modified ones are different bodies and not cached
+    key = (path, coding, len(body))
+    with s.lock:
+        v = s.encoded.get(key)
+    if v is None:
+        v = brotli.compress(body, quality=5) if coding == 'br' else gzip.compress(body, 6)
+        with s.lock:
+            s.encoded[key] = v
+    return v
+
+class handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def do_GET(self):
+        s = self.server
+        with s.lock:
+            throttled = s.max_concurrent and s.in_flight >= s.max_concurrent or not s.take_token()
+            if throttled:
+                s.throttled += 1
+            else:
+                s.in_flight += 1
+        if throttled:
+            return self.reply(429, b'too many requests')
+        try:
+            self.serve()
+        finally:
+            with s.lock:
+                s.in_flight -= 1
+
+    def serve(self):
+        s = self.server
+        delay = s.latency + random.uniform(-s.jitter, s.jitter)
+        if delay > 0:
+            time.sleep(delay / 1000)
+        if random.random() < s.error_rate:
+            return self.reply(503, b'service unavailable')
+        u = urlsplit(self.path)
+        q = parse_qs(u.query)
+        if u.path == '/api.php':
+            return self.api(q)
+        if u.path == '/index.php' and q.get('action') == ['raw']:
+            title = q.get('title', [''])[0]
+            if title not in s.wikitext:
+                return self.reply(404, b'not found')
+            return self.reply(200, self.wikitext(title)[1], s.snapshot_time, content_type='text/x-wiki; charset=UTF-8')
+        body = s.pages.get(self.path)
+        if body is None:
+            return self.reply(404, b'not found')
+        last_modified = s.snapshot_time
+        if self.path in s.modified:
+            last_modified = s.start_time
+            body = modify(body)
+        ims = self.headers.get('If-Modified-Since')
+        if ims:
+            try:
+                if email.utils.parsedate_to_datetime(ims).timestamp() >= last_modified:
+                    s.not_modified += 1
+                    return self.reply(304, b'', last_modified)
+            except (TypeError, ValueError):
+                pass
+        coding = None if s.identity else accepted_encoding(self.headers.get('Accept-Encoding'))
+        if coding:
+            body = encode(s, self.path, body, coding)
+        self.reply(200, body, last_modified, coding)
+
+    def wikitext(self, title):
+        revision, text = self.server.wikitext[title]
+        if '/' + title in self.server.modified:
+            return revision + 1, text + b'\n<!-- modified by standin_server -->'
+        return revision, text
+
+    def api(self, q):
+        if q.get('action') == ['query'] and q.get('list') == ['allpages']:
+            return self.allpages(q)
+        if q.get('action') != ['query'] or q.get('prop') != ['revisions']:
+            return self.json({'error': {'code': 'badparams', 'info': 'only action=query with prop=revisions or list=allpages is supported'}})
+        titles = q.get('titles', [''])[0].split('|')
+        if len(titles) > 50:
+            return self.json({'error': {'code': 'toomanyvalues', 'info': 'too many values supplied for parameter "titles", the limit is 50'}})
+        pages = []
+        for t in titles:
+            if t not in self.server.wikitext:
+                pages.append({'ns': 0, 'title': t, 'missing': True})
+                continue
+            revision, text = self.wikitext(t)
+            pages.append({'ns': 0, 'title': t, 'revisions': [{'revid': revision, 'slots': {'main': {'contentmodel': 'wikitext', 'content': text.decode('utf-8')}}}]})
+        self.json({'batchcomplete': True, 'query': {'pages': pages}})
+
+    def allpages(self, q):
+        ns = int(q.get('apnamespace', ['0'])[0])
+        titles = self.server.titles.get(ns, [])
+        limit = min(500, int(q.get('aplimit', ['10'])[0]))
+        start = q.get('apcontinue', q.get('apfrom', ['']))[0].replace('_', ' ')
+        i = bisect.bisect_left(titles, start)
+        r = {'batchcomplete': True, 'query': {'allpages': [{'ns': ns, 'title': t} for t in titles[i:i + limit]]}}
+        if i + limit < len(titles):
+            r['continue'] = {'apcontinue': titles[i + limit].replace(' ', '_'), 'continue': '-||'}
+        self.json(r)
+
+    def json(self, v):
+        self.reply(200, json.dumps(v).encode('utf-8'), content_type='application/json; charset=utf-8')
+
+    def reply(self, code, body, last_modified=None, coding=None, content_type='text/html; charset=UTF-8'):
+        self.send_response(code)
+        if self.server.no_keep_alive:
+            self.send_header('Connection', 'close')
+            self.close_connection = True
+        if coding:
+            self.send_header('Content-Encoding', coding)
+            self.send_header('Vary', 'Accept-Encoding')
+        if last_modified is not None:
+            self.send_header('Last-Modified', email.utils.formatdate(last_modified, usegmt=True))
+        if code == 429:
+            self.send_header('Retry-After', '1')
+        if code != 304:
+            self.send_header('Content-Type', content_type)
+            self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        if code != 304:
+            self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+def main():
+    p = argparse.ArgumentParser()
+    p.add_argument('--db', default='cppreference.db')
+    p.add_argument('--dictionaries', default='cppreference.db', help='db with the zstd dictionary table')
+    p.add_argument('--host', default='127.0.0.1')
+    p.add_argument('--port', type=int, default=8080)
+    p.add_argument('--modified', default='', help='comma separated page names edited after the snapshot')
+    p.add_argument('--latency', type=float, default=0, help='ms')
+    p.add_argument('--jitter', type=float, default=0, help='ms')
+    p.add_argument('--error-rate', type=float, default=0)
+    p.add_argument('--max-concurrent', type=int, default=0, help='requests in flight before answering 429')
+    p.add_argument('--max-rps', type=float, default=0, help='requests per second before answering 429')
+    p.add_argument('--identity', action='store_true', help='never compress responses')
+    p.add_argument('--no-keep-alive', action='store_true', help='close the connection after every response')
+    p.add_argument('--verbose', action='store_true')
+    args = p.parse_args()
+
+    s = ThreadingHTTPServer((args.host, args.port), handler)
+    decompress = make_decompressor(args.dictionaries)
+    s.pages = load_snapshot(args.db, decompress)
+    s.wikitext = load_wikitext(args.db, s.pages, decompress)
+    s.titles = list_titles(s.pages, s.wikitext)
+    s.modified = {make_path(n) for n in args.modified.split(',') if n}
+    s.snapshot_time = int(os.path.getmtime(args.db))
+    s.start_time = int(time.time())
+    s.not_modified = 0
+    s.latency = args.latency
+    s.jitter = args.jitter
+    s.error_rate = args.error_rate
+    s.max_concurrent = args.max_concurrent
+    s.lock = threading.Lock()
+    s.in_flight = 0
+    s.throttled = 0
+    s.take_token = make_token_bucket(args.max_rps)
+    s.identity = args.identity
+    s.no_keep_alive = args.no_keep_alive
+    s.encoded = {}
+    s.verbose = args.verbose
+    print(f'serving {len(s.pages)} pages and {len(s.wikitext)} wikitext sources from {args.db} on http://{args.host}:{args.port}')
+    try:
+        s.serve_forever()
+    except KeyboardInterrupt:
+        print(f'{s.not_modified} requests answered with 304, {s.throttled} with 429')
+
+if __name__ == '__main__':
+    main()
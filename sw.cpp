@@ -9,6 +9,7 @@ void build(Solution &s) {
         t +=
             //"pub.egorpugin.primitives.emitter"_dep,
             "pub.egorpugin.primitives.executor"_dep,
+            "pub.egorpugin.primitives.hash"_dep,
             "pub.egorpugin.primitives.http"_dep,
             "pub.egorpugin.primitives.templates2"_dep,
             "pub.egorpugin.primitives.sw.main"_dep,
@@ -16,6 +17,31 @@ void build(Solution &s) {
             //"org.sw.demo.zeux.pugixml"_dep,
             //"pub.egorpugin.htacg.tidy_html5"_dep,
             "org.sw.demo.sqlite3"_dep,
+            "org.sw.demo.facebook.zstd"_dep,
+            "org.sw.demo.badger.curl.libcurl"_dep,
+            "org.sw.demo.boost.interprocess"_dep,
+            "org.sw.demo.boost.pfr"_dep
+            ;
+    }
+
+    auto &bench = s.addExecutable("crawl_bench");
+    {
+        auto &t = bench;
+        t.PackageDefinitions = true;
+        t += cpp26;
+        t += "crawl_bench.cpp";
+        t += ".*\\.h"_r;
+        t -= "generated/.*"_rr;
+        t +=
+            "pub.egorpugin.primitives.executor"_dep,
+            "pub.egorpugin.primitives.hash"_dep,
+            "pub.egorpugin.primitives.http"_dep,
+            "pub.egorpugin.primitives.templates2"_dep,
+            "pub.egorpugin.primitives.sw.main"_dep,
+            "org.sw.demo.nlohmann.json.natvis"_dep,
+            "org.sw.demo.sqlite3"_dep,
+            "org.sw.demo.facebook.zstd"_dep,
+            "org.sw.demo.badger.curl.libcurl"_dep,
             "org.sw.demo.boost.pfr"_dep
             ;
     }
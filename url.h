@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// rfc 3986 reference resolution on string views.
+// Results go to caller owned buffers, so reusing them keeps the steady state allocation free.
+struct uri_ref {
+    std::string_view scheme, authority, path, query, fragment;
+    bool has_scheme{}, has_authority{}, has_query{}, has_fragment{};
+
+    uri_ref(std::string_view s) {
+        if (auto p = s.find_first_of(":/?#"); p != std::string_view::npos && p > 0 && s[p] == ':') {
+            scheme = s.substr(0, p);
+            has_scheme = true;
+            s.remove_prefix(p + 1);
+        }
+        if (s.starts_with("//")) {
+            s.remove_prefix(2);
+            auto p = std::min(s.find_first_of("/?#"), s.size());
+            authority = s.substr(0, p);
+            has_authority = true;
+            s.remove_prefix(p);
+        }
+        if (auto p = s.find('#'); p != std::string_view::npos) {
+            fragment = s.substr(p + 1);
+            has_fragment = true;
+            s = s.substr(0, p);
+        }
+        if (auto p = s.find('?'); p != std::string_view::npos) {
+            query = s.substr(p + 1);
+            has_query = true;
+            s = s.substr(0, p);
+        }
+        path = s;
+    }
+};
+
+// 5.2.4, appends to out
+inline void remove_dot_segments(std::string_view in, std::string &out) {
+    auto out_start = out.size();
+    auto remove_last_segment = [&]() {
+        auto p = out.rfind('/');
+        out.resize(p == std::string::npos || p < out_start ? out_start : p);
+    };
+    while (!in.empty()) {
+        if (in.starts_with("../")) {
+            in.remove_prefix(3);
+        } else if (in.starts_with("./")) {
+            in.remove_prefix(2);
+        } else if (in.starts_with("/./")) {
+            in.remove_prefix(2);
+        } else if (in == "/.") {
+            out += '/';
+            break;
+        } else if (in.starts_with("/../")) {
+            in.remove_prefix(3);
+            remove_last_segment();
+        } else if (in == "/..") {
+            remove_last_segment();
+            out += '/';
+            break;
+        } else if (in == "." || in == "..") {
+            break;
+        } else {
+            auto p = std::min(in.find('/', 1), in.size());
+            out += in.substr(0, p);
+            in.remove_prefix(p);
+        }
+    }
+}
+
+// 5.2.2, overwrites out
+inline void resolve_uri(std::string_view base_uri, std::string_view ref_uri, std::string &out) {
+    thread_local std::string merged;
+    uri_ref b{base_uri}, r{ref_uri};
+
+    out.clear();
+    auto add_scheme = [&](auto &&u) {
+        if (u.has_scheme) {
+            out += u.scheme;
+            out += ':';
+        }
+    };
+    auto add_authority = [&](auto &&u) {
+        if (u.has_authority) {
+            out += "//";
+            out += u.authority;
+        }
+    };
+    auto add_query = [&](auto &&u) {
+        if (u.has_query) {
+            out += '?';
+            out += u.query;
+        }
+    };
+    if (r.has_scheme) {
+        add_scheme(r);
+        add_authority(r);
+        remove_dot_segments(r.path, out);
+        add_query(r);
+    } else {
+        add_scheme(b);
+        if (r.has_authority) {
+            add_authority(r);
+            remove_dot_segments(r.path, out);
+            add_query(r);
+        } else {
+            add_authority(b);
+            if (r.path.empty()) {
+                out += b.path;
+                add_query(r.has_query ? r : b);
+            } else {
+                if (r.path.starts_with('/')) {
+                    remove_dot_segments(r.path, out);
+                } else {
+                    // 5.2.3
+                    merged.clear();
+                    if (b.has_authority && b.path.empty()) {
+                        merged += '/';
+                    } else if (auto p = b.path.rfind('/'); p != std::string_view::npos) {
+                        merged += b.path.substr(0, p + 1);
+                    }
+                    merged += r.path;
+                    remove_dot_segments(merged, out);
+                }
+                add_query(r);
+            }
+        }
+    }
+    if (r.has_fragment) {
+        out += '#';
+        out += r.fragment;
+    }
+}
+
+// %XX escapes back to bytes, malformed ones are kept as is
+inline std::string percent_decode(std::string_view in) {
+    auto hex = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    };
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        if (in[i] == '%' && i + 2 < in.size() && hex(in[i + 1]) >= 0 && hex(in[i + 2]) >= 0) {
+            out += (char)(hex(in[i + 1]) * 16 + hex(in[i + 2]));
+            i += 2;
+        } else {
+            out += in[i];
+        }
+    }
+    return out;
+}
+
+// mediawiki title as it appears in page urls: spaces become underscores,
+// everything outside of the characters wfUrlencode keeps is percent encoded
+inline std::string mediawiki_title_to_name(std::string_view title) {
+    constexpr std::string_view keep = "-_.~;:@$!*(),/";
+    std::string out;
+    out.reserve(title.size());
+    for (unsigned char c : title) {
+        if (c == ' ') {
+            out += '_';
+        } else if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || keep.contains(c)) {
+            out += c;
+        } else {
+            out += '%';
+            out += "0123456789ABCDEF"[c >> 4];
+            out += "0123456789ABCDEF"[c & 15];
+        }
+    }
+    return out;
+}
+
+// page name patterns like sqlite GLOB: '*' is any run of characters, '?' is one character,
+// [...] is one character of a set with a-z ranges, [^...] one character outside of it, ']' first in a set is literal.
+// The literal head of a pattern lets stores seek to the matching keys instead of scanning all of them.
+inline std::string_view glob_prefix(std::string_view pattern) {
+    return pattern.substr(0, pattern.find_first_of("*?["));
+}
+// matches c against the set starting at pattern[p] == '[', returns the position after the set
+// or npos when c is not in it; an unclosed set matches nothing
+inline size_t glob_match_set(std::string_view pattern, size_t p, char c) {
+    auto i = p + 1;
+    auto invert = i < pattern.size() && pattern[i] == '^';
+    i += invert;
+    bool seen{};
+    if (i < pattern.size() && pattern[i] == ']') {
+        seen = c == ']';
+        ++i;
+    }
+    unsigned char prior{}; // start of a possible range, 0 right after a range
+    for (; i < pattern.size() && pattern[i] != ']'; ++i) {
+        if (pattern[i] == '-' && prior && i + 1 < pattern.size() && pattern[i + 1] != ']') {
+            unsigned char last = pattern[++i];
+            seen |= prior <= (unsigned char)c && (unsigned char)c <= last;
+            prior = 0;
+        } else {
+            seen |= pattern[i] == c;
+            prior = pattern[i];
+        }
+    }
+    if (i == pattern.size() || seen == invert) {
+        return pattern.npos;
+    }
+    return i + 1;
+}
+inline bool glob_match(std::string_view pattern, std::string_view s) {
+    size_t p{}, i{}, star = pattern.npos, retry{};
+    while (i < s.size()) {
+        size_t next;
+        if (p < pattern.size() && pattern[p] == '[' && (next = glob_match_set(pattern, p, s[i])) != pattern.npos) {
+            p = next, ++i;
+        } else if (p < pattern.size() && pattern[p] != '[' && pattern[p] != '*' && (pattern[p] == '?' || pattern[p] == s[i])) {
+            ++p, ++i;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            retry = i;
+        } else if (star != pattern.npos) {
+            p = star + 1;
+            i = ++retry;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+// global url intern table, hands out dense 32-bit ids
+using url_id = uint32_t;
+
+struct url_table {
+    mutable std::shared_mutex m;
+    std::deque<std::string> urls; // stable addresses for the views below
+    std::unordered_map<std::string_view, url_id> ids;
+
+    url_id intern(std::string_view u) {
+        {
+            std::shared_lock lk{m};
+            if (auto i = ids.find(u); i != ids.end()) {
+                return i->second;
+            }
+        }
+        std::unique_lock lk{m};
+        if (auto i = ids.find(u); i != ids.end()) {
+            return i->second;
+        }
+        auto id = (url_id)urls.size();
+        ids.emplace(urls.emplace_back(u), id);
+        return id;
+    }
+    // references stay valid, deque does not move elements on growth
+    const std::string &operator[](url_id id) const {
+        std::shared_lock lk{m};
+        return urls[id];
+    }
+    size_t size() const {
+        std::shared_lock lk{m};
+        return urls.size();
+    }
+};
+inline url_table urls;
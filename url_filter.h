@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2024-2026 Egor Pugin <egor.pugin@gmail.com>
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <format>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// allow/deny substring rules compiled into one aho-corasick automaton, a string is checked in a single pass.
+// Patterns starting with '^' match only at the beginning. A string is rejected when any deny rule matches
+// and no allow rule does, so allow rules carve exceptions out of deny rules.
+struct url_filter {
+    enum : uint8_t {
+        deny = 1,
+        allow = 2,
+    };
+    struct node {
+        std::array<uint32_t, 256> next{}; // full dfa after build(), 0 is the root
+        uint32_t fail{};
+        uint32_t depth{};
+        uint8_t out{}; // unanchored matches ending here, including the ones reachable by fail links
+        uint8_t anchored{}; // anchored matches of exactly this node
+    };
+
+    std::vector<node> nodes{1};
+    size_t rules{};
+
+    void add(std::string_view pattern, bool is_allow) {
+        bool is_anchored = pattern.starts_with('^');
+        if (is_anchored) {
+            pattern.remove_prefix(1);
+        }
+        if (pattern.empty()) {
+            throw std::runtime_error{"empty url filter pattern"};
+        }
+        uint32_t n = 0;
+        for (unsigned char c : pattern) {
+            if (!nodes[n].next[c]) {
+                nodes[n].next[c] = nodes.size();
+                auto depth = nodes[n].depth + 1;
+                nodes.emplace_back().depth = depth;
+            }
+            n = nodes[n].next[c];
+        }
+        (is_anchored ? nodes[n].anchored : nodes[n].out) |= is_allow ? allow : deny;
+        ++rules;
+    }
+    // bfs over the trie: fail links, inherited outputs and missing transitions
+    void build() {
+        std::queue<uint32_t> q;
+        for (auto &n : nodes[0].next) {
+            if (n) {
+                q.push(n);
+            }
+        }
+        while (!q.empty()) {
+            auto u = q.front();
+            q.pop();
+            nodes[u].out |= nodes[nodes[u].fail].out;
+            for (int c = 0; c < 256; ++c) {
+                auto v = nodes[u].next[c];
+                auto f = nodes[nodes[u].fail].next[c];
+                if (v) {
+                    nodes[v].fail = f;
+                    q.push(v);
+                } else {
+                    nodes[u].next[c] = f;
+                }
+            }
+        }
+    }
+
+    bool allowed(std::string_view s) const {
+        uint8_t found{};
+        uint32_t n = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            n = nodes[n].next[(unsigned char)s[i]];
+            found |= nodes[n].out;
+            // the whole consumed prefix is in the trie only when the depth matches
+            if (nodes[n].depth == i + 1) {
+                found |= nodes[n].anchored;
+            }
+        }
+        return !(found & deny) || (found & allow);
+    }
+};
+
+// rules file:
+//
+//   # comment
+//   [href]          raw href attribute values, before resolution
+//   deny ^http
+//   [link]          resolved page names
+//   deny Special:
+//   allow Special:Allpages
+struct crawl_rules {
+    url_filter href, link;
+
+    static inline constexpr auto default_rules = R"(
+[href]
+deny ^http
+deny .php
+deny javascript:
+
+[link]
+deny Special:
+deny Template_talk:
+deny Cppreference:
+deny Talk:
+deny Category:
+deny File:
+deny MediaWiki:
+deny User:
+deny ftp:
+deny javascript:
+)";
+
+    static crawl_rules parse(std::string_view text) {
+        crawl_rules r;
+        url_filter *section{};
+        int line_no{};
+        while (!text.empty()) {
+            auto e = text.find('\n');
+            auto line = text.substr(0, e);
+            text.remove_prefix(e == std::string_view::npos ? text.size() : e + 1);
+            ++line_no;
+            if (auto p = line.find('#'); p != std::string_view::npos) {
+                line = line.substr(0, p);
+            }
+            auto trim = [](std::string_view v) {
+                while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+                while (!v.empty() && (v.back() == ' ' || v.back() == '\t' || v.back() == '\r')) v.remove_suffix(1);
+                return v;
+            };
+            line = trim(line);
+            if (line.empty()) {
+                continue;
+            }
+            if (line == "[href]") {
+                section = &r.href;
+            } else if (line == "[link]") {
+                section = &r.link;
+            } else if (auto is_allow = line.starts_with("allow "); section && (is_allow || line.starts_with("deny "))) {
+                section->add(trim(line.substr(is_allow ? 6 : 5)), is_allow);
+            } else {
+                throw std::runtime_error{std::format("bad url rule at line {}: {}", line_no, line)};
+            }
+        }
+        r.href.build();
+        r.link.build();
+        return r;
+    }
+};